@@ -0,0 +1,242 @@
+#include "affinity.h"
+#include "trace.h"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <obs.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::map<ThreadClass, std::vector<int>> Affinity::classCores;
+std::map<long, Affinity::ThreadInfo> Affinity::threads;
+std::mutex Affinity::affinity_mtx;
+
+static const char *get_thread_class_name(ThreadClass threadClass) {
+    switch (threadClass) {
+        case THREAD_RENDER:
+            return "render";
+        case THREAD_AUDIO:
+            return "audio";
+        case THREAD_ENCODER:
+            return "encoder";
+        case THREAD_TRANSCODER:
+            return "transcoder";
+        case THREAD_OUTPUT:
+            return "output";
+        case THREAD_CONTROL:
+            return "control";
+        default:
+            return "";
+    }
+}
+
+static std::string format_core_set(const std::vector<int> &cores) {
+    std::string result;
+    for (size_t i = 0; i < cores.size(); ++i) {
+        size_t j = i;
+        while (j + 1 < cores.size() && cores[j + 1] == cores[j] + 1) {
+            j++;
+        }
+        result += (result.empty() ? "" : ",") + std::to_string(cores[i]);
+        if (j > i) {
+            result += "-" + std::to_string(cores[j]);
+        }
+        i = j;
+    }
+    return result;
+}
+
+std::vector<int> parseCoreSet(const std::string &coreSet) {
+    std::vector<int> cores;
+    size_t start = 0;
+    while (start < coreSet.size()) {
+        auto end = coreSet.find(',', start);
+        if (end == std::string::npos) {
+            end = coreSet.size();
+        }
+        auto range = coreSet.substr(start, end - start);
+        auto dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if (first < 0 || last < first) {
+                throw std::invalid_argument(range);
+            }
+            for (int core = first; core <= last; ++core) {
+                cores.push_back(core);
+            }
+        } catch (std::exception &e) {
+            throw std::invalid_argument("Invalid core set: " + coreSet);
+        }
+        start = end + 1;
+    }
+    return cores;
+}
+
+#ifdef __linux__
+
+static long getThreadId() {
+    return (long) syscall(SYS_gettid);
+}
+
+static std::vector<int> getThreadCores(long tid = 0) {
+    std::vector<int> cores;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity((pid_t) tid, sizeof(set), &set) == 0) {
+        for (int core = 0; core < CPU_SETSIZE; ++core) {
+            if (CPU_ISSET(core, &set)) {
+                cores.push_back(core);
+            }
+        }
+    }
+    return cores;
+}
+
+static bool setThreadCores(const std::vector<int> &cores) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : cores) {
+        if (core < CPU_SETSIZE) {
+            CPU_SET(core, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#else
+
+static long getThreadId() {
+    static std::atomic<long> nextId(1);
+    thread_local long id = nextId++;
+    return id;
+}
+
+static std::vector<int> getThreadCores(long tid = 0) {
+    UNUSED_PARAMETER(tid);
+    return {};
+}
+
+static bool setThreadCores(const std::vector<int> &cores) {
+    UNUSED_PARAMETER(cores);
+    return false;
+}
+
+#endif
+
+ScopedAffinity::ScopedAffinity(const std::vector<int> &cores) :
+        applied(false),
+        previousCores() {
+    if (cores.empty()) {
+        return;
+    }
+    previousCores = getThreadCores();
+    applied = setThreadCores(cores);
+    if (!applied) {
+        blog(LOG_WARNING, "Failed to set thread affinity, it's only supported on Linux");
+    }
+}
+
+ScopedAffinity::~ScopedAffinity() {
+    if (applied) {
+        setThreadCores(previousCores);
+    }
+}
+
+ThreadPlacement::ThreadPlacement(ThreadClass threadClass, const std::string &name, const std::string &coreSet) :
+        tid(getThreadId()) {
+    auto cores = coreSet.empty() ? Affinity::getCores(threadClass) : parseCoreSet(coreSet);
+    if (!cores.empty() && !setThreadCores(cores)) {
+        blog(LOG_WARNING, "Failed to set affinity of thread %s, it's only supported on Linux", name.c_str());
+    }
+    Trace::setThreadName(name);
+    std::unique_lock<std::mutex> lock(Affinity::affinity_mtx);
+    Affinity::threads[tid] = {name, threadClass, cores};
+}
+
+ThreadPlacement::~ThreadPlacement() {
+    std::unique_lock<std::mutex> lock(Affinity::affinity_mtx);
+    Affinity::threads.erase(tid);
+}
+
+void Affinity::configure(const AffinitySettings &settings) {
+    std::unique_lock<std::mutex> lock(affinity_mtx);
+    classCores[THREAD_RENDER] = parseCoreSet(settings.render);
+    classCores[THREAD_AUDIO] = parseCoreSet(settings.audio);
+    classCores[THREAD_ENCODER] = parseCoreSet(settings.encoder);
+    classCores[THREAD_TRANSCODER] = parseCoreSet(settings.transcoder);
+    classCores[THREAD_OUTPUT] = parseCoreSet(settings.output);
+    classCores[THREAD_CONTROL] = parseCoreSet(settings.control);
+}
+
+std::vector<int> Affinity::getCores(ThreadClass threadClass) {
+    std::unique_lock<std::mutex> lock(affinity_mtx);
+    auto found = classCores.find(threadClass);
+    return found == classCores.end() ? std::vector<int>() : found->second;
+}
+
+Napi::Array Affinity::getPlacement(Napi::Env env) {
+    std::unique_lock<std::mutex> lock(affinity_mtx);
+    auto result = Napi::Array::New(env);
+    uint32_t index = 0;
+    auto add = [&](long tid, const std::string &name, const ThreadInfo *info, const std::vector<int> &cores, int cpu) {
+        auto thread = Napi::Object::New(env);
+        thread.Set("tid", (double) tid);
+        thread.Set("name", name);
+        if (info) {
+            thread.Set("threadClass", get_thread_class_name(info->threadClass));
+        }
+        thread.Set("cores", format_core_set(cores));
+        if (cpu >= 0) {
+            thread.Set("cpu", cpu);
+        }
+        result.Set(index++, thread);
+    };
+#ifdef __linux__
+    // Every thread of the process, including the ones of libobs and plugins.
+    DIR *dir = opendir("/proc/self/task");
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            long tid = std::stol(entry->d_name);
+            std::string taskPath = std::string("/proc/self/task/") + entry->d_name;
+            std::string name;
+            std::ifstream(taskPath + "/comm") >> name;
+
+            // The core it last ran on is the 39th field of stat, after the parenthesized name.
+            int cpu = -1;
+            std::ifstream statFile(taskPath + "/stat");
+            std::string stat((std::istreambuf_iterator<char>(statFile)), std::istreambuf_iterator<char>());
+            auto nameEnd = stat.rfind(')');
+            if (nameEnd != std::string::npos) {
+                std::istringstream fields(stat.substr(nameEnd + 2));
+                std::string field;
+                for (int i = 3; i <= 39 && fields >> field; ++i) {
+                    if (i == 39) {
+                        cpu = std::stoi(field);
+                    }
+                }
+            }
+
+            auto found = threads.find(tid);
+            const ThreadInfo *info = found == threads.end() ? nullptr : &found->second;
+            add(tid, info ? info->name : name, info, getThreadCores(tid), cpu);
+        }
+        closedir(dir);
+    }
+#else
+    for (auto &thread : threads) {
+        add(thread.first, thread.second.name, &thread.second, thread.second.cores, -1);
+    }
+#endif
+    return result;
+}
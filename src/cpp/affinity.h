@@ -0,0 +1,70 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <napi.h>
+#include "settings.h"
+
+enum ThreadClass {
+    THREAD_RENDER,
+    THREAD_AUDIO,
+    THREAD_ENCODER,
+    THREAD_TRANSCODER,
+    THREAD_OUTPUT,
+    THREAD_CONTROL,
+};
+
+// Parses core sets like "0-7,16,18" into core indexes.
+std::vector<int> parseCoreSet(const std::string &coreSet);
+
+// Pins the calling thread to the given cores until it goes out of scope.
+// Threads created meanwhile inherit the cores, that's how threads created
+// inside libobs and its plugins get placed. Only Linux is supported.
+class ScopedAffinity {
+
+public:
+    explicit ScopedAffinity(const std::vector<int> &cores);
+    ~ScopedAffinity();
+
+private:
+    bool applied;
+    std::vector<int> previousCores;
+};
+
+// Pins a thread created by obs-node for its lifetime, to coreSet or to the
+// cores of its class, and registers it for the placement report.
+class ThreadPlacement {
+
+public:
+    ThreadPlacement(ThreadClass threadClass, const std::string &name, const std::string &coreSet = "");
+    ~ThreadPlacement();
+
+private:
+    long tid;
+};
+
+class Affinity {
+
+public:
+    static void configure(const AffinitySettings &settings);
+
+    static std::vector<int> getCores(ThreadClass threadClass);
+
+    // Threads of the process with their allowed cores and the core they last ran on.
+    static Napi::Array getPlacement(Napi::Env env);
+
+private:
+    friend class ThreadPlacement;
+
+    struct ThreadInfo {
+        std::string name;
+        ThreadClass threadClass;
+        std::vector<int> cores;
+    };
+
+    static std::map<ThreadClass, std::vector<int>> classCores;
+    static std::map<long, ThreadInfo> threads;
+    static std::mutex affinity_mtx;
+};
@@ -1,6 +1,7 @@
 #include "callback.h"
 
 VolmeterCallback Callback::volmeterCallback;
+BitrateCallback Callback::bitrateCallback;
 
 void Callback::setVolmeterCallback(VolmeterCallback &callback) {
     volmeterCallback = callback;
@@ -8,4 +9,12 @@ void Callback::setVolmeterCallback(VolmeterCallback &callback) {
 
 VolmeterCallback Callback::getVolmeterCallback() {
     return volmeterCallback;
+}
+
+void Callback::setBitrateCallback(BitrateCallback &callback) {
+    bitrateCallback = callback;
+}
+
+BitrateCallback Callback::getBitrateCallback() {
+    return bitrateCallback;
 }
\ No newline at end of file
@@ -9,11 +9,21 @@ typedef std::function<void(
         std::vector<float> &peak,
         std::vector<float> &input_peak)> VolmeterCallback;
 
+typedef std::function<void(
+        const std::string &outputId,
+        int bitrateKbps,
+        int previousBitrateKbps,
+        float congestion,
+        int droppedFrames)> BitrateCallback;
+
 class Callback {
 public:
     static void setVolmeterCallback(VolmeterCallback &callback);
     static VolmeterCallback getVolmeterCallback();
+    static void setBitrateCallback(BitrateCallback &callback);
+    static BitrateCallback getBitrateCallback();
 
 private:
     static VolmeterCallback volmeterCallback;
+    static BitrateCallback bitrateCallback;
 };
@@ -3,6 +3,12 @@
 
 #include "display.h"
 #include "./platform/platform.h"
+#include "trace.h"
+#include <cmath>
+#include <util/platform.h>
+#ifdef DISPLAY_GPU_TIMING
+#include <util/util_uint64.h>
+#endif
 #ifdef _WIN32
 #include <Windows.h>
 #include <Dwmapi.h>
@@ -115,7 +121,10 @@ void Display::SystemWorker() {
 }
 #endif
 
-Display::Display(void *parentHandle, int scaleFactor, const std::vector<std::string> &sourceIds) {
+Display::Display(void *parentHandle, int scaleFactor, const std::vector<std::shared_ptr<SourceHandle>> &handles,
+                 const DisplaySettings &settings, PreviewCache *previewCache) :
+        settings(settings),
+        previewCache(previewCache) {
     this->parentHandle = parentHandle;
     this->scaleFactor = scaleFactor;
 
@@ -173,7 +182,9 @@ Display::Display(void *parentHandle, int scaleFactor, const std::vector<std::str
     }
 
     // obs sources
-    addSources(sourceIds);
+    addSources(handles);
+    // Created at 0x0, stay paused until the first move.
+    updatePaused();
 
     // draw callback
     obs_display_add_draw_callback(obs_display, displayCallback, this);
@@ -182,6 +193,21 @@ Display::Display(void *parentHandle, int scaleFactor, const std::vector<std::str
 Display::~Display() {
     obs_display_remove_draw_callback(obs_display, displayCallback, this);
     clearSources();
+    obs_enter_graphics();
+    if (frame_texrender) {
+        gs_texrender_destroy(frame_texrender);
+    }
+#ifdef DISPLAY_GPU_TIMING
+    for (int i = 0; i < DISPLAY_GPU_TIMERS; ++i) {
+        if (timers[i]) {
+            gs_timer_destroy(timers[i]);
+        }
+        if (timer_ranges[i]) {
+            gs_timer_range_destroy(timer_ranges[i]);
+        }
+    }
+#endif
+    obs_leave_graphics();
     if (obs_display) {
         obs_display_destroy(obs_display);
     }
@@ -227,27 +253,192 @@ void Display::move(int x, int y, int width, int height) {
     this->y = y;
     this->width = width;
     this->height = height;
+    // A collapsed preview is not visible, don't render it.
+    updatePaused();
 }
 
-void Display::update(const std::vector<std::string> &sourceIds) {
+void Display::update(const std::vector<std::shared_ptr<SourceHandle>> &handles) {
     std::unique_lock<std::mutex> lock(sources_mtx);
     clearSources();
-    addSources(sourceIds);
+    addSources(handles);
+}
+
+void Display::pause() {
+    userPaused = true;
+    updatePaused();
+}
+
+void Display::resume() {
+    userPaused = false;
+    updatePaused();
+}
+
+void Display::updatePaused() {
+    std::unique_lock<std::mutex> lock(sources_mtx);
+    bool value = userPaused || width == 0 || height == 0;
+    if (paused == value) {
+        return;
+    }
+    // Paused display releases the showing reference, so its sources are not
+    // kept rendering for this display only.
+    for (const auto &handle : handles) {
+        if (value) {
+            handle->decShowing();
+        } else {
+            handle->incShowing();
+        }
+    }
+    obs_display_set_enabled(obs_display, !value);
+    paused = value;
 }
 
 void Display::displayCallback(void *displayPtr, uint32_t cx, uint32_t cy) {
     auto *dp = static_cast<Display *>(displayPtr);
+    if (dp->paused) {
+        return;
+    }
+    TRACE_SCOPE("Display::displayCallback");
+
+    gs_projection_push();
+
+    dp->sources_mtx.lock();
+    if (dp->settings.fps <= 0) {
+        dp->render(cx, cy);
+    } else {
+        // Only render sources at the display frame rate, and show the last frame in between.
+        uint64_t now = os_gettime_ns();
+        uint64_t interval = 1000000000ULL / dp->settings.fps;
+        uint64_t tolerance = obs_get_frame_interval_ns() / 2;
+        if (!dp->frame_texrender) {
+            dp->frame_texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+        }
+        gs_texture_t *texture = gs_texrender_get_texture(dp->frame_texrender);
+        bool resized = !texture || gs_texture_get_width(texture) != cx || gs_texture_get_height(texture) != cy;
+        if (resized || now + tolerance - dp->last_render_time >= interval) {
+            dp->last_render_time = now;
+            gs_texrender_reset(dp->frame_texrender);
+            if (gs_texrender_begin(dp->frame_texrender, cx, cy)) {
+                vec4 background = {};
+                vec4_zero(&background);
+                gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+                dp->render(cx, cy);
+                gs_texrender_end(dp->frame_texrender);
+            }
+            texture = gs_texrender_get_texture(dp->frame_texrender);
+        } else {
+            dp->skipped_frames++;
+        }
+        if (texture) {
+            gs_ortho(0.0f, float(cx), 0.0f, float(cy), -1.0f, 1.0f);
+            gs_set_viewport(0, 0, (int) cx, (int) cy);
+            gs_blend_state_push();
+            gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+            PreviewCache::draw(texture, cx, cy);
+            gs_blend_state_pop();
+        }
+    }
+    dp->sources_mtx.unlock();
+
+    gs_projection_pop();
+}
+
+void Display::render(uint32_t cx, uint32_t cy) {
+#ifdef DISPLAY_GPU_TIMING
+    int index = timer_index;
+    timer_index = (timer_index + 1) % DISPLAY_GPU_TIMERS;
+    if (timer_pending[timer_index]) {
+        readGpuTimer(timer_index);
+    }
+    if (!timers[index]) {
+        timer_ranges[index] = gs_timer_range_create();
+        timers[index] = gs_timer_create();
+    }
+    if (timers[index] && timer_ranges[index]) {
+        gs_timer_range_begin(timer_ranges[index]);
+        gs_timer_begin(timers[index]);
+    }
+#else
+    uint64_t start = os_gettime_ns();
+#endif
+
+    // Hold the current sources of the handles while rendering this frame,
+    // a restarted source may release its old one at any time.
+    for (const auto &handle : handles) {
+        obs_source_t *obs_source = handle->getRef();
+        if (obs_source) {
+            obs_sources.push_back(obs_source);
+        }
+    }
+    if (settings.multiview) {
+        renderMultiview(obs_sources, settings.columns, previewCache, cx, cy);
+    } else {
+        renderSources();
+    }
+    for (const auto &obs_source : obs_sources) {
+        obs_source_release(obs_source);
+    }
+    obs_sources.clear();
+    rendered_frames++;
+
+#ifdef DISPLAY_GPU_TIMING
+    if (timers[index] && timer_ranges[index]) {
+        gs_timer_end(timers[index]);
+        gs_timer_range_end(timer_ranges[index]);
+        timer_pending[index] = true;
+    }
+#else
+    addRenderTime(os_gettime_ns() - start);
+#endif
+}
+
+void Display::addRenderTime(uint64_t elapsed) {
+    timed_frames++;
+    total_render_ns += elapsed;
+    if (elapsed > max_render_ns) {
+        max_render_ns = elapsed;
+    }
+}
 
+#ifdef DISPLAY_GPU_TIMING
+
+void Display::readGpuTimer(int index) {
+    timer_pending[index] = false;
+    bool disjoint = false;
+    uint64_t frequency = 0;
+    uint64_t ticks = 0;
+    if (!gs_timer_range_get_data(timer_ranges[index], &disjoint, &frequency) ||
+        !gs_timer_get_data(timers[index], &ticks) || disjoint || !frequency) {
+        return;
+    }
+    addRenderTime(util_mul_div64(ticks, 1000000000ULL, frequency));
+}
+#endif
+
+Napi::Object Display::getStats(Napi::Env env) {
+    std::unique_lock<std::mutex> lock(sources_mtx);
+    auto result = Napi::Object::New(env);
+    result.Set("fps", settings.fps);
+    result.Set("paused", paused.load());
+    result.Set("renderedFrames", (double) rendered_frames);
+    result.Set("skippedFrames", (double) skipped_frames);
+    result.Set("averageRenderTimeMs", timed_frames ? (double) total_render_ns / timed_frames / 1000000.0 : 0.0);
+    result.Set("maxRenderTimeMs", (double) max_render_ns / 1000000.0);
+#ifdef DISPLAY_GPU_TIMING
+    result.Set("renderTimeClock", "gpu");
+#else
+    result.Set("renderTimeClock", "cpu");
+#endif
+    return result;
+}
+
+void Display::renderSources() {
     obs_video_info ovi = {};
     obs_get_video_info(&ovi);
     uint32_t base_width = ovi.base_width;
     uint32_t base_height = ovi.base_height;
 
-    gs_projection_push();
-
-    dp->sources_mtx.lock();
-    for (size_t i = 0; i < dp->obs_sources.size(); ++i) {
-        auto source = dp->obs_sources[i];
+    for (size_t i = 0; i < obs_sources.size(); ++i) {
+        auto source = obs_sources[i];
         if (i == 0) {
             uint32_t source_width = obs_source_get_width(source);
             uint32_t source_height = obs_source_get_height(source);
@@ -259,11 +450,18 @@ void Display::displayCallback(void *displayPtr, uint32_t cx, uint32_t cy) {
             int x, y;
             int newCX, newCY;
             float scale;
-            if (GetScaleAndCenterPos(source_width, source_height, dp->width, dp->height, x, y, scale)) {
+            if (GetScaleAndCenterPos(source_width, source_height, width, height, x, y, scale)) {
                 newCX = int(scale * float(source_width));
                 newCY = int(scale * float(source_height));
+                // Use the cached preview instead of sampling the full resolution source,
+                // it must be rendered before setting up the display viewport.
+                gs_texture_t *texture = previewCache->getTexture(source, newCX * scaleFactor, newCY * scaleFactor);
                 gs_ortho(0.0f, float(source_width), 0.0f, float(source_height), -1.0f, 1.0f);
                 gs_set_viewport(x, y, newCX, newCY);
+                if (texture) {
+                    PreviewCache::draw(texture, source_width, source_height);
+                    continue;
+                }
             } else {
                 gs_ortho(0.0f, float(source_width), 0.0f, float(source_height), -1.0f, 1.0f);
             }
@@ -273,25 +471,82 @@ void Display::displayCallback(void *displayPtr, uint32_t cx, uint32_t cy) {
         }
         obs_source_video_render(source);
     }
-    dp->sources_mtx.unlock();
+}
 
-    gs_projection_pop();
+void Display::renderMultiview(const std::vector<obs_source_t *> &obs_sources, int columns,
+                              PreviewCache *previewCache, uint32_t cx, uint32_t cy) {
+    if (obs_sources.empty()) {
+        return;
+    }
+    auto count = (uint32_t) obs_sources.size();
+    if (columns <= 0) {
+        columns = (int) std::ceil(std::sqrt((double) count));
+    }
+    uint32_t rows = (count + columns - 1) / columns;
+    uint32_t cellCX = cx / columns;
+    uint32_t cellCY = cy / rows;
+    if (cellCX == 0 || cellCY == 0) {
+        return;
+    }
+
+    struct Cell {
+        gs_texture_t *texture;
+        float x;
+        float y;
+        uint32_t cx;
+        uint32_t cy;
+    };
+
+    // Render all cached previews first, texture rendering changes the viewport.
+    std::vector<Cell> cells;
+    for (size_t i = 0; i < obs_sources.size(); ++i) {
+        uint32_t source_width = obs_source_get_width(obs_sources[i]);
+        uint32_t source_height = obs_source_get_height(obs_sources[i]);
+        int x, y;
+        float scale;
+        if (!GetScaleAndCenterPos(source_width, source_height, cellCX, cellCY, x, y, scale)) {
+            continue;
+        }
+        uint32_t newCX = uint32_t(scale * float(source_width));
+        uint32_t newCY = uint32_t(scale * float(source_height));
+        gs_texture_t *texture = previewCache->getTexture(obs_sources[i], newCX, newCY);
+        if (!texture) {
+            continue;
+        }
+        cells.push_back(Cell{
+                .texture = texture,
+                .x = float((i % columns) * cellCX + x),
+                .y = float((i / columns) * cellCY + y),
+                .cx = newCX,
+                .cy = newCY,
+        });
+    }
+
+    // Draw the whole layout in one projection.
+    gs_ortho(0.0f, float(cx), 0.0f, float(cy), -1.0f, 1.0f);
+    gs_set_viewport(0, 0, (int) cx, (int) cy);
+    for (const auto &cell : cells) {
+        gs_matrix_push();
+        gs_matrix_translate3f(cell.x, cell.y, 0.0f);
+        PreviewCache::draw(cell.texture, cell.cx, cell.cy);
+        gs_matrix_pop();
+    }
 }
 
-void Display::addSources(const std::vector<std::string> &sourceIds) {
-    for (const auto& sourceId : sourceIds) {
-        obs_source_t *obs_source = obs_get_source_by_name(sourceId.c_str());
-        if (obs_source) {
-            obs_source_inc_showing(obs_source);
-            obs_sources.push_back(obs_source);
+void Display::addSources(const std::vector<std::shared_ptr<SourceHandle>> &handles) {
+    for (const auto &handle : handles) {
+        if (!paused) {
+            handle->incShowing();
         }
+        this->handles.push_back(handle);
     }
 }
 
 void Display::clearSources() {
-    for (const auto &obs_source : obs_sources) {
-        obs_source_dec_showing(obs_source);
-        obs_source_release(obs_source);
+    for (const auto &handle : handles) {
+        if (!paused) {
+            handle->decShowing();
+        }
     }
-    obs_sources.clear();
+    handles.clear();
 }
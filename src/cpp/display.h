@@ -1,38 +1,85 @@
 #pragma once
 
 #include "settings.h"
+#include "preview_cache.h"
+#include "source_handle.h"
+#include <atomic>
 #include <string>
 #include <thread>
 #include <obs.h>
 #include <graphics/graphics.h>
 #include "utils.h"
 
+// GPU timer queries arrived in libobs 27, with older ones the render is
+// timed on the CPU, which only covers submitting it.
+#if LIBOBS_API_MAJOR_VER >= 27
+#define DISPLAY_GPU_TIMING
+#define DISPLAY_GPU_TIMERS 2
+#endif
+
 class Display {
 
 public:
-    Display(void *parentHandle, int scaleFactor, const std::vector<std::string> &sourceIds);
+    Display(void *parentHandle, int scaleFactor, const std::vector<std::shared_ptr<SourceHandle>> &handles,
+            const DisplaySettings &settings, PreviewCache *previewCache);
 
     ~Display();
 
     void move(int x, int y, int width, int height);
 
-    void update(const std::vector<std::string> &sourceIds);
+    void update(const std::vector<std::shared_ptr<SourceHandle>> &handles);
+
+    void pause();
+
+    void resume();
+
+    Napi::Object getStats(Napi::Env env);
+
+    static void renderMultiview(const std::vector<obs_source_t *> &obs_sources, int columns,
+                                PreviewCache *previewCache, uint32_t cx, uint32_t cy);
 
 private:
     static void displayCallback(void *displayPtr, uint32_t cx, uint32_t cy);
-    void addSources(const std::vector<std::string> &sourceIds);
+    void updatePaused();
+    void render(uint32_t cx, uint32_t cy);
+    void renderSources();
+    void addRenderTime(uint64_t elapsed);
+#ifdef DISPLAY_GPU_TIMING
+    void readGpuTimer(int index);
+#endif
+    void addSources(const std::vector<std::shared_ptr<SourceHandle>> &handles);
     void clearSources();
     void SystemWorker();
 
+    DisplaySettings settings;
+    PreviewCache *previewCache;
     void *parentHandle; // For MacOS is NSView**, For Windows is HWND*
     int scaleFactor;
     void *windowHandle;
     obs_display_t *obs_display;
-    std::vector<obs_source_t *> obs_sources;
+    std::vector<std::shared_ptr<SourceHandle>> handles;
+    std::vector<obs_source_t *> obs_sources; // Sources of the frame being rendered
     int x = 0;
     int y = 0;
     int width = 0;
     int height = 0;
+    std::atomic<bool> paused{false}; // Read by the graphics thread
+    std::atomic<bool> userPaused{false};
+    gs_texrender_t *frame_texrender = nullptr;
+    uint64_t last_render_time = 0;
+    uint64_t rendered_frames = 0;
+    uint64_t skipped_frames = 0;
+#ifdef DISPLAY_GPU_TIMING
+    // GPU time of the preview render, read back one frame late so the
+    // queries are done without stalling the graphics thread.
+    gs_timer_range_t *timer_ranges[DISPLAY_GPU_TIMERS] = {};
+    gs_timer_t *timers[DISPLAY_GPU_TIMERS] = {};
+    bool timer_pending[DISPLAY_GPU_TIMERS] = {};
+    int timer_index = 0;
+#endif
+    uint64_t timed_frames = 0;
+    uint64_t total_render_ns = 0;
+    uint64_t max_render_ns = 0;
     std::mutex sources_mtx;
     std::thread worker;
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "encoder_benchmark.h"
+#include "packet_output.h"
+#include "studio.h"
+#include <obs.h>
+#include <algorithm>
+#include <chrono>
+#include <util/platform.h>
+
+#define BASELINE_DURATION 2000 // milliseconds
+
+Napi::Object EncoderBenchmarkResult::toNapiObject(Napi::Env env) const {
+    auto result = Napi::Object::New(env);
+    result.Set("encoder", encoderId);
+    result.Set("settings", settingsJson);
+    result.Set("fps", fps);
+    result.Set("targetFps", targetFps);
+    result.Set("cpuPercent", cpuPercent);
+    result.Set("skippedFrames", skippedFrames);
+    if (!error.empty()) {
+        result.Set("error", error);
+    }
+    return result;
+}
+
+std::vector<EncoderBenchmarkResult> EncoderBenchmark::run(const EncoderBenchmarkSettings &settings) {
+    // CPU of the process without the candidates, what is left is the encoder's share.
+    os_cpu_usage_info_t *cpu_info = os_cpu_usage_info_start();
+    bool aborted = !Studio::benchmarkSleep(std::chrono::milliseconds(BASELINE_DURATION));
+    double baselineCpu = os_cpu_usage_info_query(cpu_info);
+    os_cpu_usage_info_destroy(cpu_info);
+    if (aborted) {
+        throw std::runtime_error("Benchmark aborted by shutdown.");
+    }
+
+    std::vector<EncoderBenchmarkResult> results;
+    for (auto &candidate : settings.candidates) {
+        if (Studio::isBenchmarkAborted()) {
+            throw std::runtime_error("Benchmark aborted by shutdown.");
+        }
+        try {
+            results.push_back(runCandidate(settings, candidate, baselineCpu));
+        } catch (std::exception &e) {
+            EncoderBenchmarkResult result;
+            result.encoderId = candidate.encoderId;
+            result.settingsJson = candidate.settingsJson;
+            result.error = e.what();
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+EncoderBenchmarkResult EncoderBenchmark::runCandidate(const EncoderBenchmarkSettings &settings,
+                                                      const EncoderBenchmarkSettings::Candidate &candidate,
+                                                      double baselineCpu) {
+    EncoderBenchmarkResult result;
+    result.encoderId = candidate.encoderId;
+    result.settingsJson = candidate.settingsJson;
+
+    obs_video_info ovi = {};
+    obs_get_video_info(&ovi);
+    result.targetFps = (double) ovi.fps_num / ovi.fps_den;
+
+    obs_data_t *video_encoder_settings = obs_data_create();
+    obs_data_set_string(video_encoder_settings, "rate_control", "CBR");
+    obs_data_set_int(video_encoder_settings, "bitrate", settings.bitrateKbps);
+    if (!candidate.settingsJson.empty()) {
+        obs_data_t *encoder_specific_settings = obs_data_create_from_json(candidate.settingsJson.c_str());
+        obs_data_apply(video_encoder_settings, encoder_specific_settings);
+        obs_data_release(encoder_specific_settings);
+    }
+    obs_encoder_t *video_encoder = obs_video_encoder_create(candidate.encoderId.c_str(), "benchmark video enc",
+                                                            video_encoder_settings, nullptr);
+    obs_data_release(video_encoder_settings);
+    if (!video_encoder) {
+        throw std::runtime_error("Failed to create video encoder: " + candidate.encoderId);
+    }
+    obs_encoder_set_scaled_size(video_encoder, settings.width, settings.height);
+    obs_encoder_set_video(video_encoder, obs_get_video());
+
+    obs_encoder_t *audio_encoder = obs_audio_encoder_create("ffmpeg_aac", "benchmark aac enc", nullptr, 0, nullptr);
+    if (!audio_encoder) {
+        obs_encoder_release(video_encoder);
+        throw std::runtime_error("Failed to create audio encoder.");
+    }
+    obs_encoder_set_audio(audio_encoder, obs_get_audio());
+
+    PacketOutput *packet_output = nullptr;
+    try {
+        packet_output = new PacketOutput("benchmark_" + candidate.encoderId, video_encoder, {audio_encoder});
+        packet_output->start();
+
+        uint32_t skippedStart = video_output_get_skipped_frames(obs_get_video());
+        int framesStart = packet_output->getVideoPackets();
+        uint64_t timeStart = os_gettime_ns();
+        os_cpu_usage_info_t *cpu_info = os_cpu_usage_info_start();
+
+        bool aborted = !Studio::benchmarkSleep(std::chrono::seconds(settings.durationSec));
+
+        double cpu = os_cpu_usage_info_query(cpu_info);
+        os_cpu_usage_info_destroy(cpu_info);
+        if (aborted) {
+            throw std::runtime_error("Benchmark aborted by shutdown.");
+        }
+        uint64_t elapsedNs = os_gettime_ns() - timeStart;
+        result.fps = (double) (packet_output->getVideoPackets() - framesStart) * 1000000000.0 / (double) elapsedNs;
+        result.cpuPercent = std::max(0.0, cpu - baselineCpu);
+        result.skippedFrames = (int) (video_output_get_skipped_frames(obs_get_video()) - skippedStart);
+    } catch (...) {
+        delete packet_output;
+        obs_encoder_release(video_encoder);
+        obs_encoder_release(audio_encoder);
+        throw;
+    }
+
+    delete packet_output;
+    obs_encoder_release(video_encoder);
+    obs_encoder_release(audio_encoder);
+    return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "settings.h"
+
+struct EncoderBenchmarkResult {
+    std::string encoderId;
+    std::string settingsJson;
+    double fps = 0;
+    double targetFps = 0;
+    double cpuPercent = 0; // Of the whole machine, above the idle baseline
+    int skippedFrames = 0;
+    std::string error;
+
+    Napi::Object toNapiObject(Napi::Env env) const;
+};
+
+// Runs each candidate encoder in turn on the program video for a while, and
+// measures the encoded fps and the extra CPU it costs. libobs feeds encoders
+// at the video clock, so fps below the target means the machine can't keep up.
+class EncoderBenchmark {
+
+public:
+    static std::vector<EncoderBenchmarkResult> run(const EncoderBenchmarkSettings &settings);
+
+private:
+    static EncoderBenchmarkResult runCandidate(const EncoderBenchmarkSettings &settings,
+                                               const EncoderBenchmarkSettings::Candidate &candidate,
+                                               double baselineCpu);
+};
@@ -0,0 +1,75 @@
+#include "encoder_budget.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <obs.h>
+
+#define MAX_X264_THREADS 16
+#define MAX_SLICED_THREADS 4 // above it frame threads scale better
+#define LOOKAHEAD_PER_THREAD 5
+#define MIN_LOOKAHEAD 5
+#define MAX_LOOKAHEAD 30
+
+int EncoderBudget::cores = 0;
+int64_t EncoderBudget::expectedPixels = 0;
+std::map<const void *, EncoderBudget::Share> EncoderBudget::encoders;
+std::mutex EncoderBudget::encoders_mtx;
+
+static bool has_option(const std::string &x264opts, const std::string &name) {
+    std::istringstream stream(x264opts);
+    std::string option;
+    while (stream >> option) {
+        if (option.compare(0, option.find('='), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void EncoderBudget::setCores(int cores, int64_t expectedPixels) {
+    std::unique_lock<std::mutex> lock(encoders_mtx);
+    EncoderBudget::cores = cores;
+    EncoderBudget::expectedPixels = expectedPixels;
+}
+
+std::string EncoderBudget::acquire(const void *owner, int width, int height, const std::string &x264opts) {
+    std::unique_lock<std::mutex> lock(encoders_mtx);
+    if (cores <= 0) {
+        return x264opts;
+    }
+    encoders.erase(owner);
+    int64_t pixels = (int64_t) width * height;
+    int64_t totalPixels = pixels;
+    int assigned = 0;
+    for (auto &encoder : encoders) {
+        totalPixels += encoder.second.pixels;
+        assigned += encoder.second.threads;
+    }
+
+    // Encoders started earlier keep their threads until they restart, a new
+    // one only gets what they left.
+    double share = (double) cores * pixels / std::max(totalPixels, expectedPixels);
+    int threads = std::min((int) std::lround(share), cores - assigned);
+    threads = std::clamp(threads, 1, MAX_X264_THREADS);
+    encoders[owner] = {pixels, threads};
+    bool sliced = threads > 1 && threads <= MAX_SLICED_THREADS;
+    int lookahead = std::clamp(threads * LOOKAHEAD_PER_THREAD, MIN_LOOKAHEAD, MAX_LOOKAHEAD);
+
+    std::string result = x264opts;
+    auto append = [&result, &x264opts](const std::string &name, int value) {
+        if (!has_option(x264opts, name)) {
+            result += (result.empty() ? "" : " ") + name + "=" + std::to_string(value);
+        }
+    };
+    append("threads", threads);
+    append("sliced-threads", sliced ? 1 : 0);
+    append("rc-lookahead", lookahead);
+    blog(LOG_INFO, "Encoder budget: %d of %d cores for %dx%d, x264opts: %s",
+         threads, cores, width, height, result.c_str());
+    return result;
+}
+
+void EncoderBudget::release(const void *owner) {
+    std::unique_lock<std::mutex> lock(encoders_mtx);
+    encoders.erase(owner);
+}
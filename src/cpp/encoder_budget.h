@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Shares a number of CPU cores between the x264 encoders of all outputs by
+// their resolution, so many encoders in one process don't oversubscribe the
+// machine with x264's default thread count each. Threads are handed out from
+// what is still unassigned, so the total stays within the cores, apart from
+// the one thread every encoder gets.
+class EncoderBudget {
+
+public:
+    // expectedPixels sizes the shares when encoders start one by one, 0 sizes
+    // them against the encoders running so far.
+    static void setCores(int cores, int64_t expectedPixels);
+
+    // Registers the encoder of owner and returns x264opts with threads,
+    // sliced-threads and rc-lookahead for its share. Options already set in
+    // x264opts are kept.
+    static std::string acquire(const void *owner, int width, int height, const std::string &x264opts);
+
+    static void release(const void *owner);
+
+private:
+    struct Share {
+        int64_t pixels;
+        int threads;
+    };
+
+    static int cores;
+    static int64_t expectedPixels;
+    static std::map<const void *, Share> encoders;
+    static std::mutex encoders_mtx;
+};
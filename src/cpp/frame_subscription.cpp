@@ -0,0 +1,205 @@
+#include "frame_subscription.h"
+#include <cstring>
+#include <media-io/video-io.h>
+#include <util/bmem.h>
+
+static inline video_format get_video_format(const std::string &format) {
+    if (format == "RGBA") {
+        return VIDEO_FORMAT_RGBA;
+    } else if (format == "NV12") {
+        return VIDEO_FORMAT_NV12;
+    } else if (format == "I420") {
+        return VIDEO_FORMAT_I420;
+    }
+    return VIDEO_FORMAT_BGRA;
+}
+
+FramePool::FramePool(size_t bufferSize, int count) :
+        bufferSize(bufferSize),
+        buffers(),
+        available(),
+        inUse(),
+        nextGeneration(0),
+        mtx() {
+    for (int i = 0; i < count; ++i) {
+        auto buffer = (uint8_t *) bmalloc(bufferSize);
+        buffers.push_back(buffer);
+        available.push_back(buffer);
+    }
+}
+
+FramePool::~FramePool() {
+    for (auto buffer : buffers) {
+        bfree(buffer);
+    }
+}
+
+uint8_t *FramePool::acquire(uint64_t &generation) {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (available.empty()) {
+        return nullptr;
+    }
+    uint8_t *buffer = available.back();
+    available.pop_back();
+    generation = ++nextGeneration;
+    inUse[buffer] = generation;
+    return buffer;
+}
+
+void FramePool::release(uint8_t *buffer, uint64_t generation) {
+    std::unique_lock<std::mutex> lock(mtx);
+    auto found = inUse.find(buffer);
+    if (found != inUse.end() && found->second == generation) {
+        inUse.erase(found);
+        available.push_back(buffer);
+    }
+}
+
+FrameSubscription::FrameSubscription(Napi::Env env, const Napi::Function &callback, video_t *video,
+                                     const FrameSubscriptionSettings &settings) :
+        settings(settings),
+        video(video),
+        scale_info(),
+        pool(nullptr),
+        tsfn(),
+        interval(0),
+        next_time(0),
+        dropped(0) {
+    const video_output_info *voi = video_output_get_info(video);
+    uint32_t width = settings.width > 0 ? settings.width : voi->width;
+    scale_info.format = get_video_format(settings.format);
+    scale_info.width = width & ~1u;
+    scale_info.height = (uint32_t) ((uint64_t) width * voi->height / voi->width) & ~1u;
+    scale_info.range = VIDEO_RANGE_DEFAULT;
+    scale_info.colorspace = VIDEO_CS_DEFAULT;
+    if (scale_info.width == 0 || scale_info.height == 0) {
+        throw std::invalid_argument("Invalid frame width: " + std::to_string(width));
+    }
+    if (settings.fps > 0) {
+        interval = 1000000000ULL / settings.fps;
+    }
+
+    bool packed = scale_info.format == VIDEO_FORMAT_BGRA || scale_info.format == VIDEO_FORMAT_RGBA;
+    size_t size = packed ? (size_t) scale_info.width * scale_info.height * 4 :
+                  (size_t) scale_info.width * scale_info.height * 3 / 2;
+    pool = std::make_shared<FramePool>(size, settings.poolSize);
+
+    // The queue holds at most one call per pooled buffer.
+    tsfn = Napi::ThreadSafeFunction::New(env, callback, "FrameSubscription", settings.poolSize, 1);
+
+    if (!video_output_connect(video, &scale_info, video_callback, this)) {
+        tsfn.Release();
+        throw std::runtime_error("Failed to connect frame subscription to video output");
+    }
+}
+
+FrameSubscription::~FrameSubscription() {
+    video_output_disconnect(video, video_callback, this);
+    tsfn.Release();
+    if (dropped > 0) {
+        blog(LOG_INFO, "Frame subscription dropped %llu frames", (unsigned long long) dropped.load());
+    }
+}
+
+std::string FrameSubscription::getOffscreenDisplay() {
+    return settings.offscreenDisplay;
+}
+
+void FrameSubscription::video_callback(void *param, struct video_data *frame) {
+    auto subscription = (FrameSubscription *) param;
+    if (subscription->interval > 0) {
+        if (frame->timestamp < subscription->next_time) {
+            return;
+        }
+        // Keep the cadence, unless we are behind by more than one frame.
+        subscription->next_time += subscription->interval;
+        if (subscription->next_time < frame->timestamp) {
+            subscription->next_time = frame->timestamp + subscription->interval;
+        }
+    }
+
+    auto &pool = subscription->pool;
+    uint64_t generation = 0;
+    uint8_t *buffer = pool->acquire(generation);
+    if (!buffer) {
+        subscription->dropped++;
+        return;
+    }
+
+    uint32_t width = subscription->scale_info.width;
+    uint32_t height = subscription->scale_info.height;
+    uint8_t *dst = buffer;
+    switch (subscription->scale_info.format) {
+        case VIDEO_FORMAT_NV12:
+            for (uint32_t i = 0; i < height; i++, dst += width) {
+                memcpy(dst, frame->data[0] + (size_t) frame->linesize[0] * i, width);
+            }
+            for (uint32_t i = 0; i < height / 2; i++, dst += width) {
+                memcpy(dst, frame->data[1] + (size_t) frame->linesize[1] * i, width);
+            }
+            break;
+        case VIDEO_FORMAT_I420:
+            for (uint32_t i = 0; i < height; i++, dst += width) {
+                memcpy(dst, frame->data[0] + (size_t) frame->linesize[0] * i, width);
+            }
+            for (int plane = 1; plane < 3; plane++) {
+                for (uint32_t i = 0; i < height / 2; i++, dst += width / 2) {
+                    memcpy(dst, frame->data[plane] + (size_t) frame->linesize[plane] * i, width / 2);
+                }
+            }
+            break;
+        default:
+            for (uint32_t i = 0; i < height; i++, dst += width * 4) {
+                memcpy(dst, frame->data[0] + (size_t) frame->linesize[0] * i, width * 4);
+            }
+            break;
+    }
+
+    auto data = new FrameData{
+            .pool = pool,
+            .buffer = buffer,
+            .generation = generation,
+            .width = width,
+            .height = height,
+            .format = subscription->settings.format,
+            .timestamp = frame->timestamp,
+            .dropped = subscription->dropped,
+    };
+
+    auto callback = [](Napi::Env env, Napi::Function jsCallback, FrameData *data) {
+        auto pool = data->pool;
+        uint8_t *buffer = data->buffer;
+        uint64_t generation = data->generation;
+        if (env == nullptr) {
+            // The subscription is gone before the frame is delivered.
+            pool->release(buffer, generation);
+            delete data;
+            return;
+        }
+        // The ArrayBuffer keeps the pool alive, its memory is returned to the pool when collected.
+        auto arrayBuffer = Napi::ArrayBuffer::New(
+                env, buffer, pool->getBufferSize(),
+                [](Napi::Env env, void *buffer, FrameData *hint) {
+                    hint->pool->release((uint8_t *) buffer, hint->generation);
+                    delete hint;
+                },
+                data);
+        auto result = Napi::Object::New(env);
+        result.Set("data", arrayBuffer);
+        result.Set("width", data->width);
+        result.Set("height", data->height);
+        result.Set("format", data->format);
+        result.Set("timestamp", (double) data->timestamp);
+        result.Set("dropped", (double) data->dropped);
+        result.Set("release", Napi::Function::New(env, [pool, buffer, generation](const Napi::CallbackInfo &info) {
+            pool->release(buffer, generation);
+        }));
+        jsCallback.Call({result});
+    };
+
+    if (subscription->tsfn.NonBlockingCall(data, callback) != napi_ok) {
+        pool->release(buffer, generation);
+        delete data;
+        subscription->dropped++;
+    }
+}
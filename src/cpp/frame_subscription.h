@@ -0,0 +1,69 @@
+#pragma once
+
+#include "settings.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <obs.h>
+
+// Fixed set of frame buffers shared with JavaScript. A buffer goes back to
+// the pool when it's released explicitly or its ArrayBuffer is collected,
+// whichever comes first. Each use of a buffer has its own generation, so a
+// late release of a previous use doesn't return a buffer in use again.
+class FramePool {
+
+public:
+    FramePool(size_t bufferSize, int count);
+    ~FramePool();
+
+    uint8_t *acquire(uint64_t &generation);
+
+    void release(uint8_t *buffer, uint64_t generation);
+
+    size_t getBufferSize() { return bufferSize; }
+
+private:
+    size_t bufferSize;
+    std::vector<uint8_t *> buffers;
+    std::vector<uint8_t *> available;
+    std::map<uint8_t *, uint64_t> inUse;
+    uint64_t nextGeneration;
+    std::mutex mtx;
+};
+
+// Delivers raw frames of a video output to a JavaScript callback. Frames are
+// dropped, never queued, when the pool has no free buffer left.
+class FrameSubscription {
+
+public:
+    FrameSubscription(Napi::Env env, const Napi::Function &callback, video_t *video,
+                      const FrameSubscriptionSettings &settings);
+    ~FrameSubscription();
+
+    std::string getOffscreenDisplay();
+
+private:
+    struct FrameData {
+        std::shared_ptr<FramePool> pool;
+        uint8_t *buffer;
+        uint64_t generation;
+        uint32_t width;
+        uint32_t height;
+        std::string format;
+        uint64_t timestamp;
+        uint64_t dropped;
+    };
+
+    static void video_callback(void *param, struct video_data *frame);
+
+    FrameSubscriptionSettings settings;
+    video_t *video;
+    video_scale_info scale_info;
+    std::shared_ptr<FramePool> pool;
+    Napi::ThreadSafeFunction tsfn;
+    uint64_t interval;
+    uint64_t next_time;
+    std::atomic<uint64_t> dropped;
+};
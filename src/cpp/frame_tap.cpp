@@ -0,0 +1,171 @@
+#include "frame_tap.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <media-io/audio-io.h>
+#include <media-io/video-io.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static inline uint32_t get_video_size(video_format format, uint32_t width, uint32_t height) {
+    return format == VIDEO_FORMAT_NV12 ? width * height * 3 / 2 : width * height * 4;
+}
+
+FrameTap::FrameTap(const FrameTapSettings &settings, video_t *video, audio_t *audio) :
+        settings(settings),
+        video(video),
+        audio(audio),
+        scale_info(),
+        convert_info(),
+        memory_size(0),
+        header(nullptr),
+        slot(nullptr),
+        write_mtx() {
+#ifdef _WIN32
+    throw std::runtime_error("Frame taps are not supported on Windows");
+#else
+    const video_output_info *voi = video_output_get_info(video);
+    scale_info.format = settings.videoFormat == "BGRA" ? VIDEO_FORMAT_BGRA : VIDEO_FORMAT_NV12;
+    scale_info.width = settings.width > 0 ? settings.width : voi->width;
+    scale_info.height = settings.height > 0 ? settings.height : voi->height;
+    scale_info.range = VIDEO_RANGE_DEFAULT;
+    scale_info.colorspace = VIDEO_CS_DEFAULT;
+
+    uint32_t channels = 0;
+    uint32_t sample_rate = 0;
+    if (audio) {
+        const audio_output_info *aoi = audio_output_get_info(audio);
+        convert_info.samples_per_sec = aoi->samples_per_sec;
+        convert_info.format = AUDIO_FORMAT_FLOAT_PLANAR;
+        convert_info.speakers = aoi->speakers;
+        channels = (uint32_t) get_audio_channels(aoi->speakers);
+        sample_rate = aoi->samples_per_sec;
+    }
+
+    uint32_t payload_size = std::max(get_video_size(scale_info.format, scale_info.width, scale_info.height),
+                                     (uint32_t) (AUDIO_OUTPUT_FRAMES * channels * sizeof(float)));
+    uint32_t slot_size = (uint32_t) sizeof(FrameTapSlot) + ((payload_size + 63) & ~63u);
+    memory_size = sizeof(FrameTapHeader) + (size_t) slot_size * settings.slots;
+
+    // Never share a segment, its header and its unlink belong to this tap.
+    int fd = shm_open(settings.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        throw std::runtime_error("Shared memory " + settings.name + " already exists, frame tap names should be unique");
+    } else if (fd < 0) {
+        throw std::runtime_error("Failed to open shared memory " + settings.name + ": " + strerror(errno));
+    }
+    if (ftruncate(fd, (off_t) memory_size) != 0) {
+        close(fd);
+        shm_unlink(settings.name.c_str());
+        throw std::runtime_error("Failed to resize shared memory " + settings.name + ": " + strerror(errno));
+    }
+    void *memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(settings.name.c_str());
+        throw std::runtime_error("Failed to map shared memory " + settings.name + ": " + strerror(errno));
+    }
+
+    memset(memory, 0, memory_size);
+    header = (FrameTapHeader *) memory;
+    header->magic = FRAME_TAP_MAGIC;
+    header->version = FRAME_TAP_VERSION;
+    header->slotCount = settings.slots;
+    header->slotSize = slot_size;
+    header->videoFormat = scale_info.format;
+    header->width = scale_info.width;
+    header->height = scale_info.height;
+    header->sampleRate = sample_rate;
+    header->channels = channels;
+    header->writeCount.store(0);
+
+    if (!video_output_connect(video, &scale_info, video_callback, this)) {
+        munmap(header, memory_size);
+        shm_unlink(settings.name.c_str());
+        throw std::runtime_error("Failed to connect frame tap to video output");
+    }
+    if (audio) {
+        audio_output_connect(audio, 0, &convert_info, audio_callback, this);
+    }
+    blog(LOG_INFO, "[%s] frame tap started, %dx%d, %d slots of %d bytes", settings.name.c_str(),
+         scale_info.width, scale_info.height, settings.slots, slot_size);
+#endif
+}
+
+FrameTap::~FrameTap() {
+#ifndef _WIN32
+    video_output_disconnect(video, video_callback, this);
+    if (audio) {
+        audio_output_disconnect(audio, 0, audio_callback, this);
+    }
+    munmap(header, memory_size);
+    shm_unlink(settings.name.c_str());
+#endif
+}
+
+std::string FrameTap::getOffscreenDisplay() {
+    return settings.offscreenDisplay;
+}
+
+void FrameTap::video_callback(void *param, struct video_data *frame) {
+    auto tap = (FrameTap *) param;
+    uint32_t width = tap->scale_info.width;
+    uint32_t height = tap->scale_info.height;
+    std::unique_lock<std::mutex> lock(tap->write_mtx);
+    uint8_t *payload = tap->beginSlot(FRAME_TAP_SLOT_VIDEO, get_video_size(tap->scale_info.format, width, height),
+                                      frame->timestamp, 0);
+    if (tap->scale_info.format == VIDEO_FORMAT_NV12) {
+        // Y plane, then interleaved UV plane of half height
+        for (uint32_t i = 0; i < height; i++) {
+            memcpy(payload + (size_t) width * i, frame->data[0] + (size_t) frame->linesize[0] * i, width);
+        }
+        payload += (size_t) width * height;
+        for (uint32_t i = 0; i < height / 2; i++) {
+            memcpy(payload + (size_t) width * i, frame->data[1] + (size_t) frame->linesize[1] * i, width);
+        }
+    } else {
+        for (uint32_t i = 0; i < height; i++) {
+            memcpy(payload + (size_t) width * 4 * i, frame->data[0] + (size_t) frame->linesize[0] * i, width * 4);
+        }
+    }
+    tap->endSlot();
+}
+
+void FrameTap::audio_callback(void *param, size_t mix_idx, struct audio_data *data) {
+    UNUSED_PARAMETER(mix_idx);
+    auto tap = (FrameTap *) param;
+    uint32_t channels = tap->header->channels;
+    uint32_t frames = std::min(data->frames, (uint32_t) AUDIO_OUTPUT_FRAMES);
+    size_t plane_size = frames * sizeof(float);
+    std::unique_lock<std::mutex> lock(tap->write_mtx);
+    uint8_t *payload = tap->beginSlot(FRAME_TAP_SLOT_AUDIO, (uint32_t) (plane_size * channels), data->timestamp,
+                                      frames);
+    for (uint32_t c = 0; c < channels; c++) {
+        if (data->data[c]) {
+            memcpy(payload + plane_size * c, data->data[c], plane_size);
+        } else {
+            memset(payload + plane_size * c, 0, plane_size);
+        }
+    }
+    tap->endSlot();
+}
+
+uint8_t *FrameTap::beginSlot(FrameTapSlotType type, uint32_t size, uint64_t timestamp, uint32_t frames) {
+    uint64_t index = header->writeCount.load(std::memory_order_relaxed) % header->slotCount;
+    slot = (FrameTapSlot *) ((uint8_t *) header + sizeof(FrameTapHeader) + index * header->slotSize);
+    // An odd sequence marks the slot as being written.
+    slot->sequence.fetch_add(1, std::memory_order_acq_rel);
+    slot->type = type;
+    slot->size = size;
+    slot->timestamp = timestamp;
+    slot->frames = frames;
+    return (uint8_t *) slot + sizeof(FrameTapSlot);
+}
+
+void FrameTap::endSlot() {
+    slot->sequence.fetch_add(1, std::memory_order_release);
+    header->writeCount.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "settings.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <obs.h>
+
+#define FRAME_TAP_MAGIC 0x5041544f // "OTAP"
+#define FRAME_TAP_VERSION 1
+
+enum FrameTapSlotType {
+    FRAME_TAP_SLOT_VIDEO = 1,
+    FRAME_TAP_SLOT_AUDIO = 2,
+};
+
+// Shared memory layout, a FrameTapHeader followed by slotCount slots of
+// slotSize bytes. Each slot starts with a FrameTapSlot and its payload:
+// video planes packed without padding (NV12: Y then UV, BGRA: one plane),
+// or audio channels as planar float.
+//
+// Slots are written in order, slot n goes to n % slotCount. A reader
+// follows writeCount, and checks that the slot sequence is even and the
+// same before and after reading the payload, an odd or changed sequence
+// means the writer has overwritten the slot.
+struct FrameTapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    uint32_t videoFormat; // enum video_format
+    uint32_t width;
+    uint32_t height;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t reserved;
+    std::atomic<uint64_t> writeCount;
+};
+
+struct FrameTapSlot {
+    std::atomic<uint64_t> sequence;
+    uint32_t type; // FrameTapSlotType
+    uint32_t size; // payload size
+    uint64_t timestamp;
+    uint32_t frames; // audio frames per channel
+    uint32_t reserved;
+};
+
+// Writes raw frames of a video output, and optionally an audio output,
+// into a POSIX shared memory ring for local consumers.
+class FrameTap {
+
+public:
+    FrameTap(const FrameTapSettings &settings, video_t *video, audio_t *audio);
+    ~FrameTap();
+
+    std::string getOffscreenDisplay();
+
+private:
+    static void video_callback(void *param, struct video_data *frame);
+    static void audio_callback(void *param, size_t mix_idx, struct audio_data *data);
+
+    uint8_t *beginSlot(FrameTapSlotType type, uint32_t size, uint64_t timestamp, uint32_t frames);
+    void endSlot();
+
+    FrameTapSettings settings;
+    video_t *video;
+    audio_t *audio;
+    video_scale_info scale_info;
+    audio_convert_info convert_info;
+    size_t memory_size;
+    FrameTapHeader *header;
+    FrameTapSlot *slot;
+    std::mutex write_mtx;
+};
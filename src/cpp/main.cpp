@@ -2,9 +2,16 @@
 #include "utils.h"
 #include "callback.h"
 #include "overlay.h"
+#include "encoder_benchmark.h"
+#include "pipeline_benchmark.h"
+#include "affinity.h"
+#include "metrics.h"
+#include "trace.h"
 #include <memory>
 #include <condition_variable>
+#include <thread>
 #include <napi.h>
+#include <util/platform.h>
 
 #ifdef __linux__
 // Need QT for linux to setup OpenGL properly.
@@ -17,6 +24,7 @@ Studio *studio = nullptr;
 Settings *settings = nullptr;
 Napi::ThreadSafeFunction volmeter_thread = nullptr;
 Napi::ThreadSafeFunction cef_queue_task_thread = nullptr;
+Napi::ThreadSafeFunction bitrate_thread = nullptr;
 
 struct VolmeterData {
     std::string sceneId;
@@ -27,6 +35,14 @@ struct VolmeterData {
     std::vector<float> input_peak;
 };
 
+struct BitrateData {
+    std::string outputId;
+    int bitrateKbps;
+    int previousBitrateKbps;
+    float congestion;
+    int droppedFrames;
+};
+
 struct CefCallbackData {
     std::function<void()> task;
 };
@@ -140,7 +156,27 @@ Napi::Value switchToScene(const Napi::CallbackInfo &info) {
     int transitionMs = info[2].As<Napi::Number>();
     uint64_t timestamp = info[3].IsUndefined() ? 0 : std::stoull((std::string)info[3].As<Napi::String>());
     int tBarValue = info[4].IsUndefined() ? 0 : info[4].As<Napi::Number>();
-    TRY_METHOD(studio->switchToScene(sceneId, transitionType, transitionMs, timestamp, tBarValue))
+    uint64_t tBarTimestamp = info[5].IsUndefined() ? 0 : info[5].As<Napi::Number>().Int64Value();
+    TRY_METHOD(studio->switchToScene(sceneId, transitionType, transitionMs, timestamp, tBarValue, tBarTimestamp))
+    return info.Env().Undefined();
+}
+
+Napi::Value loadTransition(const Napi::CallbackInfo &info) {
+    std::string transitionType = info[0].As<Napi::String>();
+    std::string settingsJson = info[1].IsUndefined() || info[1].IsNull() ? "" : NapiUtil::stringify(info.Env(), info[1]);
+    TRY_METHOD(studio->loadTransition(transitionType, settingsJson))
+    return info.Env().Undefined();
+}
+
+Napi::Value prepareScene(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    TRY_METHOD(studio->prepareScene(sceneId))
+    return info.Env().Undefined();
+}
+
+Napi::Value unprepareScene(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    TRY_METHOD(studio->unprepareScene(sceneId))
     return info.Env().Undefined();
 }
 
@@ -158,6 +194,61 @@ Napi::Value updateOutput(const Napi::CallbackInfo &info) {
     return info.Env().Undefined();
 }
 
+Napi::Object getOutputStats(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    Napi::Object result;
+    TRY_METHOD(result = studio->getOutputStats(info.Env(), id))
+    return result;
+}
+
+Napi::Value saveReplay(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    std::string path = info[1].As<Napi::String>();
+
+    auto deferred = Napi::Promise::Deferred::New(info.Env());
+    auto tsfn = Napi::ThreadSafeFunction::New(
+            info.Env(),
+            Napi::Function::New(info.Env(), [](const Napi::CallbackInfo &info) {}),
+            "Replay threadSafe function",
+            0,
+            1);
+
+    // Resolved from the replay buffer's "saved" signal, the mux can take seconds.
+    auto callback = [deferred, tsfn](const std::string &replayPath, const std::string &error) {
+        tsfn.BlockingCall([deferred, replayPath, error](Napi::Env env, Napi::Function jsCallback) {
+            if (error.empty()) {
+                deferred.Resolve(Napi::String::New(env, replayPath));
+            } else {
+                deferred.Reject(Napi::Error::New(env, error).Value());
+            }
+        });
+        (const_cast<Napi::ThreadSafeFunction&>(tsfn)).Release();
+    };
+    try {
+        studio->saveReplay(id, path, callback);
+    } catch (std::exception &e) {
+        tsfn.Release();
+        deferred.Reject(Napi::Error::New(info.Env(), e.what()).Value());
+    }
+    return deferred.Promise();
+}
+
+Napi::Value playReplay(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    std::string sceneId = info[1].As<Napi::String>();
+    std::string sourceId = info[2].As<Napi::String>();
+    auto settings = Napi::Object::New(info.Env());
+    if (info.Length() > 3 && info[3].IsObject()) {
+        auto userSettings = info[3].As<Napi::Object>();
+        auto names = userSettings.GetPropertyNames();
+        for (uint32_t i = 0; i < names.Length(); ++i) {
+            settings.Set(names.Get(i), userSettings.Get(names.Get(i)));
+        }
+    }
+    TRY_METHOD(studio->playReplay(id, sceneId, sourceId, settings))
+    return info.Env().Undefined();
+}
+
 Napi::Value removeOutput(const Napi::CallbackInfo &info) {
     std::string id = info[0].As<Napi::String>();
     TRY_METHOD(studio->removeOutput(id));
@@ -168,8 +259,9 @@ Napi::Value createDisplay(const Napi::CallbackInfo &info) {
     std::string displayName = info[0].As<Napi::String>();
     void *parentHandle = info[1].As<Napi::Buffer<void *>>().Data();
     int scaleFactor = info[2].As<Napi::Number>();
-    std::vector<std::string> sourceIds = NapiUtil::getStringArray(info[3].As<Napi::Array>());
-    TRY_METHOD(studio->createDisplay(displayName, parentHandle, scaleFactor, sourceIds))
+    auto displaySources = DisplaySource::fromArray(info[3].As<Napi::Array>());
+    auto displaySettings = info[4].IsUndefined() ? DisplaySettings() : DisplaySettings(info[4].As<Napi::Object>());
+    TRY_METHOD(studio->createDisplay(displayName, parentHandle, scaleFactor, displaySources, displaySettings))
     return info.Env().Undefined();
 }
 
@@ -191,8 +283,82 @@ Napi::Value moveDisplay(const Napi::CallbackInfo &info) {
 
 Napi::Value updateDisplay(const Napi::CallbackInfo &info) {
     std::string displayName = info[0].As<Napi::String>();
-    std::vector<std::string> sourceIds = NapiUtil::getStringArray(info[1].As<Napi::Array>());
-    TRY_METHOD(studio->updateDisplay(displayName, sourceIds))
+    auto displaySources = DisplaySource::fromArray(info[1].As<Napi::Array>());
+    TRY_METHOD(studio->updateDisplay(displayName, displaySources))
+    return info.Env().Undefined();
+}
+
+Napi::Value pauseDisplay(const Napi::CallbackInfo &info) {
+    std::string displayName = info[0].As<Napi::String>();
+    TRY_METHOD(studio->pauseDisplay(displayName))
+    return info.Env().Undefined();
+}
+
+Napi::Value resumeDisplay(const Napi::CallbackInfo &info) {
+    std::string displayName = info[0].As<Napi::String>();
+    TRY_METHOD(studio->resumeDisplay(displayName))
+    return info.Env().Undefined();
+}
+
+Napi::Object getDisplayStats(const Napi::CallbackInfo &info) {
+    std::string displayName = info[0].As<Napi::String>();
+    Napi::Object result;
+    TRY_METHOD(result = studio->getDisplayStats(info.Env(), displayName))
+    return result;
+}
+
+Napi::Value createOffscreenDisplay(const Napi::CallbackInfo &info) {
+    std::string displayName = info[0].As<Napi::String>();
+    auto displaySources = DisplaySource::fromArray(info[1].As<Napi::Array>());
+    TRY_METHOD(studio->createOffscreenDisplay(displayName, displaySources,
+                                              OffscreenDisplaySettings(info[2].As<Napi::Object>())))
+    return info.Env().Undefined();
+}
+
+Napi::Value destroyOffscreenDisplay(const Napi::CallbackInfo &info) {
+    std::string displayName = info[0].As<Napi::String>();
+    TRY_METHOD(studio->destroyOffscreenDisplay(displayName))
+    return info.Env().Undefined();
+}
+
+Napi::Value updateOffscreenDisplay(const Napi::CallbackInfo &info) {
+    std::string displayName = info[0].As<Napi::String>();
+    auto displaySources = DisplaySource::fromArray(info[1].As<Napi::Array>());
+    TRY_METHOD(studio->updateOffscreenDisplay(displayName, displaySources))
+    return info.Env().Undefined();
+}
+
+Napi::Value getOffscreenDisplayFrame(const Napi::CallbackInfo &info) {
+    std::string displayName = info[0].As<Napi::String>();
+    Napi::Value result = info.Env().Undefined();
+    TRY_METHOD(result = studio->getOffscreenDisplayFrame(info.Env(), displayName))
+    return result;
+}
+
+Napi::Value addFrameTap(const Napi::CallbackInfo &info) {
+    std::string frameTapId = info[0].As<Napi::String>();
+    TRY_METHOD(studio->addFrameTap(frameTapId, FrameTapSettings(info[1].As<Napi::Object>())))
+    return info.Env().Undefined();
+}
+
+Napi::Value removeFrameTap(const Napi::CallbackInfo &info) {
+    std::string frameTapId = info[0].As<Napi::String>();
+    TRY_METHOD(studio->removeFrameTap(frameTapId))
+    return info.Env().Undefined();
+}
+
+Napi::Value subscribeFrames(const Napi::CallbackInfo &info) {
+    auto callback = info[1].As<Napi::Function>();
+    int subscriptionId = 0;
+    TRY_METHOD(subscriptionId = studio->subscribeFrames(info.Env(),
+                                                        FrameSubscriptionSettings(info[0].As<Napi::Object>()),
+                                                        callback))
+    return Napi::Number::New(info.Env(), subscriptionId);
+}
+
+Napi::Value unsubscribeFrames(const Napi::CallbackInfo &info) {
+    int subscriptionId = info[0].As<Napi::Number>();
+    TRY_METHOD(studio->unsubscribeFrames(subscriptionId))
     return info.Env().Undefined();
 }
 
@@ -254,6 +420,51 @@ Napi::Value addVolmeterCallback(const Napi::CallbackInfo &info) {
     return info.Env().Undefined();
 }
 
+Napi::Value addBitrateCallback(const Napi::CallbackInfo &info) {
+    auto callback = info[0].As<Napi::Function>();
+    bitrate_thread = Napi::ThreadSafeFunction::New(
+            info.Env(),
+            callback,
+            "BitrateThread",
+            0,
+            1
+    );
+
+    BitrateCallback bitrateCallback = [](const std::string &outputId,
+                                         int bitrateKbps,
+                                         int previousBitrateKbps,
+                                         float congestion,
+                                         int droppedFrames) {
+
+        auto data = new BitrateData {
+            .outputId = outputId,
+            .bitrateKbps = bitrateKbps,
+            .previousBitrateKbps = previousBitrateKbps,
+            .congestion = congestion,
+            .droppedFrames = droppedFrames,
+        };
+
+        auto callback = [](Napi::Env env, Napi::Function jsCallback, BitrateData* data) {
+            auto change = Napi::Object::New(env);
+            change.Set("bitrateKbps", data->bitrateKbps);
+            change.Set("previousBitrateKbps", data->previousBitrateKbps);
+            change.Set("congestion", data->congestion);
+            change.Set("droppedFrames", data->droppedFrames);
+            jsCallback.Call({
+                Napi::String::New(env, data->outputId),
+                change
+            });
+            delete data;
+        };
+
+        if (bitrate_thread) {
+            bitrate_thread.BlockingCall(data, callback);
+        }
+    };
+    TRY_METHOD(Callback::setBitrateCallback(bitrateCallback))
+    return info.Env().Undefined();
+}
+
 Napi::Object getAudio(const Napi::CallbackInfo &info) {
     Napi::Object result;
     TRY_METHOD(result = studio->getAudio(info.Env()))
@@ -295,6 +506,101 @@ Napi::Value screenshot(const Napi::CallbackInfo &info) {
     return deferred.Promise();
 }
 
+Napi::Value benchmarkEncoders(const Napi::CallbackInfo &info) {
+    std::shared_ptr<EncoderBenchmarkSettings> benchmarkSettings;
+    TRY_METHOD(benchmarkSettings = std::make_shared<EncoderBenchmarkSettings>(info[0].As<Napi::Object>()))
+    if (!benchmarkSettings) {
+        return info.Env().Undefined();
+    }
+    bool started = false;
+    TRY_METHOD(Studio::beginBenchmark(); started = true)
+    if (!started) {
+        return info.Env().Undefined();
+    }
+
+    auto deferred = Napi::Promise::Deferred::New(info.Env());
+    auto tsfn = Napi::ThreadSafeFunction::New(
+            info.Env(),
+            Napi::Function::New(info.Env(), [](const Napi::CallbackInfo &info) {}),
+            "Benchmark threadSafe function",
+            0,
+            1);
+
+    // Each candidate runs for durationSec, keep the js thread free meanwhile.
+    std::thread([deferred, tsfn, benchmarkSettings]() {
+        std::vector<EncoderBenchmarkResult> results;
+        std::string error;
+        try {
+            results = EncoderBenchmark::run(*benchmarkSettings);
+        } catch (std::exception &e) {
+            error = e.what();
+        }
+        Studio::endBenchmark();
+        tsfn.BlockingCall([deferred, results, error](Napi::Env env, Napi::Function jsCallback) {
+            if (!error.empty()) {
+                deferred.Reject(Napi::Error::New(env, error).Value());
+                return;
+            }
+            auto array = Napi::Array::New(env, results.size());
+            for (size_t i = 0; i < results.size(); ++i) {
+                array.Set(i, results[i].toNapiObject(env));
+            }
+            deferred.Resolve(array);
+        });
+        (const_cast<Napi::ThreadSafeFunction&>(tsfn)).Release();
+    }).detach();
+
+    return deferred.Promise();
+}
+
+Napi::Value benchmarkPipeline(const Napi::CallbackInfo &info) {
+    std::shared_ptr<PipelineBenchmarkSettings> benchmarkSettings;
+    TRY_METHOD(benchmarkSettings = std::make_shared<PipelineBenchmarkSettings>(info[0].As<Napi::Object>()))
+    if (!benchmarkSettings) {
+        return info.Env().Undefined();
+    }
+    bool started = false;
+    TRY_METHOD(Studio::beginBenchmark(); started = true)
+    if (!started) {
+        return info.Env().Undefined();
+    }
+
+    auto deferred = Napi::Promise::Deferred::New(info.Env());
+    auto tsfn = Napi::ThreadSafeFunction::New(
+            info.Env(),
+            Napi::Function::New(info.Env(), [](const Napi::CallbackInfo &info) {}),
+            "Pipeline benchmark threadSafe function",
+            0,
+            1);
+
+    std::thread([deferred, tsfn, benchmarkSettings]() {
+        std::shared_ptr<PipelineBenchmarkResult> result;
+        std::string error;
+        try {
+            result = std::make_shared<PipelineBenchmarkResult>(PipelineBenchmark::run(*benchmarkSettings));
+        } catch (std::exception &e) {
+            error = e.what();
+        }
+        Studio::endBenchmark();
+        tsfn.BlockingCall([deferred, result, error](Napi::Env env, Napi::Function jsCallback) {
+            if (result) {
+                deferred.Resolve(result->toNapiObject(env));
+            } else {
+                deferred.Reject(Napi::Error::New(env, error).Value());
+            }
+        });
+        (const_cast<Napi::ThreadSafeFunction&>(tsfn)).Release();
+    }).detach();
+
+    return deferred.Promise();
+}
+
+Napi::Value getThreadPlacement(const Napi::CallbackInfo &info) {
+    Napi::Value result;
+    TRY_METHOD(result = Affinity::getPlacement(info.Env()))
+    return result;
+}
+
 Napi::Value addOverlay(const Napi::CallbackInfo &info) {
     auto overlay = Overlay::create(info[0].As<Napi::Object>(), settings);
     TRY_METHOD(studio->addOverlay(overlay))
@@ -337,34 +643,94 @@ Napi::Value getSourceServerTimestamp(const Napi::CallbackInfo &info) {
     return Napi::String::New(info.Env(), std::to_string(source->getServerTimestamp()));
 }
 
+Napi::Value getMetrics(const Napi::CallbackInfo &info) {
+    std::string result;
+    TRY_METHOD(result = Metrics::collect())
+    return Napi::String::New(info.Env(), result);
+}
+
+Napi::Value startTrace(const Napi::CallbackInfo &info) {
+    int eventsPerThread = info[0].IsUndefined() ? TRACE_DEFAULT_EVENTS : info[0].As<Napi::Number>();
+    TRY_METHOD(Trace::start(eventsPerThread))
+    return info.Env().Undefined();
+}
+
+Napi::Value stopTrace(const Napi::CallbackInfo &info) {
+    Trace::stop();
+    return info.Env().Undefined();
+}
+
+Napi::Value dumpTrace(const Napi::CallbackInfo &info) {
+    std::string result;
+    TRY_METHOD(result = Trace::dump())
+    return Napi::String::New(info.Env(), result);
+}
+
+// Times every exported function for the metrics, the name comes as the function data.
+template <auto fn>
+Napi::Value measureCall(const Napi::CallbackInfo &info) {
+    uint64_t start = os_gettime_ns();
+    Napi::Value result = fn(info);
+    Metrics::observeNapiCall((const char *) info.Data(), os_gettime_ns() - start);
+    return result;
+}
+
+#define EXPORT_FUNCTION(name) \
+    exports.Set(Napi::String::New(env, #name), Napi::Function::New(env, measureCall<name>, #name, (void *) #name))
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
-    exports.Set(Napi::String::New(env, "setObsPath"), Napi::Function::New(env, setObsPath));
-    exports.Set(Napi::String::New(env, "startup"), Napi::Function::New(env, startup));
-    exports.Set(Napi::String::New(env, "shutdown"), Napi::Function::New(env, shutdown));
-    exports.Set(Napi::String::New(env, "addScene"), Napi::Function::New(env, addScene));
-    exports.Set(Napi::String::New(env, "removeScene"), Napi::Function::New(env, removeScene));
-    exports.Set(Napi::String::New(env, "addSource"), Napi::Function::New(env, addSource));
-    exports.Set(Napi::String::New(env, "getSource"), Napi::Function::New(env, getSource));
-    exports.Set(Napi::String::New(env, "getSourceServerTimestamp"), Napi::Function::New(env, getSourceServerTimestamp));
-    exports.Set(Napi::String::New(env, "updateSource"), Napi::Function::New(env, updateSource));
-    exports.Set(Napi::String::New(env, "restartSource"), Napi::Function::New(env, restartSource));
-    exports.Set(Napi::String::New(env, "switchToScene"), Napi::Function::New(env, switchToScene));
-    exports.Set(Napi::String::New(env, "addOutput"), Napi::Function::New(env, addOutput));
-    exports.Set(Napi::String::New(env, "updateOutput"), Napi::Function::New(env, updateOutput));
-    exports.Set(Napi::String::New(env, "removeOutput"), Napi::Function::New(env, removeOutput));
-    exports.Set(Napi::String::New(env, "createDisplay"), Napi::Function::New(env, createDisplay));
-    exports.Set(Napi::String::New(env, "destroyDisplay"), Napi::Function::New(env, destroyDisplay));
-    exports.Set(Napi::String::New(env, "moveDisplay"), Napi::Function::New(env, moveDisplay));
-    exports.Set(Napi::String::New(env, "updateDisplay"), Napi::Function::New(env, updateDisplay));
-    exports.Set(Napi::String::New(env, "addVolmeterCallback"), Napi::Function::New(env, addVolmeterCallback));
-    exports.Set(Napi::String::New(env, "getAudio"), Napi::Function::New(env, getAudio));
-    exports.Set(Napi::String::New(env, "updateAudio"), Napi::Function::New(env, updateAudio));
-    exports.Set(Napi::String::New(env, "screenshot"), Napi::Function::New(env, screenshot));
-    exports.Set(Napi::String::New(env, "addOverlay"), Napi::Function::New(env, addOverlay));
-    exports.Set(Napi::String::New(env, "removeOverlay"), Napi::Function::New(env, removeOverlay));
-    exports.Set(Napi::String::New(env, "upOverlay"), Napi::Function::New(env, upOverlay));
-    exports.Set(Napi::String::New(env, "downOverlay"), Napi::Function::New(env, downOverlay));
-    exports.Set(Napi::String::New(env, "getOverlays"), Napi::Function::New(env, getOverlays));
+    EXPORT_FUNCTION(setObsPath);
+    EXPORT_FUNCTION(startup);
+    EXPORT_FUNCTION(shutdown);
+    EXPORT_FUNCTION(addScene);
+    EXPORT_FUNCTION(removeScene);
+    EXPORT_FUNCTION(addSource);
+    EXPORT_FUNCTION(getSource);
+    EXPORT_FUNCTION(getSourceServerTimestamp);
+    EXPORT_FUNCTION(updateSource);
+    EXPORT_FUNCTION(restartSource);
+    EXPORT_FUNCTION(switchToScene);
+    EXPORT_FUNCTION(loadTransition);
+    EXPORT_FUNCTION(prepareScene);
+    EXPORT_FUNCTION(unprepareScene);
+    EXPORT_FUNCTION(addOutput);
+    EXPORT_FUNCTION(updateOutput);
+    EXPORT_FUNCTION(removeOutput);
+    EXPORT_FUNCTION(getOutputStats);
+    EXPORT_FUNCTION(saveReplay);
+    EXPORT_FUNCTION(playReplay);
+    EXPORT_FUNCTION(createDisplay);
+    EXPORT_FUNCTION(destroyDisplay);
+    EXPORT_FUNCTION(moveDisplay);
+    EXPORT_FUNCTION(updateDisplay);
+    EXPORT_FUNCTION(pauseDisplay);
+    EXPORT_FUNCTION(resumeDisplay);
+    EXPORT_FUNCTION(getDisplayStats);
+    EXPORT_FUNCTION(createOffscreenDisplay);
+    EXPORT_FUNCTION(destroyOffscreenDisplay);
+    EXPORT_FUNCTION(updateOffscreenDisplay);
+    EXPORT_FUNCTION(getOffscreenDisplayFrame);
+    EXPORT_FUNCTION(addFrameTap);
+    EXPORT_FUNCTION(removeFrameTap);
+    EXPORT_FUNCTION(subscribeFrames);
+    EXPORT_FUNCTION(unsubscribeFrames);
+    EXPORT_FUNCTION(addVolmeterCallback);
+    EXPORT_FUNCTION(addBitrateCallback);
+    EXPORT_FUNCTION(getAudio);
+    EXPORT_FUNCTION(updateAudio);
+    EXPORT_FUNCTION(screenshot);
+    EXPORT_FUNCTION(benchmarkEncoders);
+    EXPORT_FUNCTION(benchmarkPipeline);
+    EXPORT_FUNCTION(getThreadPlacement);
+    EXPORT_FUNCTION(getMetrics);
+    EXPORT_FUNCTION(startTrace);
+    EXPORT_FUNCTION(stopTrace);
+    EXPORT_FUNCTION(dumpTrace);
+    EXPORT_FUNCTION(addOverlay);
+    EXPORT_FUNCTION(removeOverlay);
+    EXPORT_FUNCTION(upOverlay);
+    EXPORT_FUNCTION(downOverlay);
+    EXPORT_FUNCTION(getOverlays);
     return exports;
 }
 
@@ -0,0 +1,261 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include "metrics.h"
+#include "affinity.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <obs.h>
+#include <util/bmem.h>
+#ifdef _WIN32
+#define CLOSE_SOCKET closesocket
+#define INVALID_SOCKET_VALUE INVALID_SOCKET
+typedef SOCKET socket_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define CLOSE_SOCKET close
+#define INVALID_SOCKET_VALUE (-1)
+typedef int socket_t;
+#endif
+
+#define SERVER_POLL_INTERVAL 200000 // microseconds
+#define CLIENT_TIMEOUT 2000 // milliseconds
+
+std::map<const void *, Metrics::Collector> Metrics::collectors;
+std::map<std::string, Metrics::CallStats> Metrics::napiCalls;
+std::atomic<uint64_t> Metrics::volmeterCallbacks(0);
+std::mutex Metrics::metrics_mtx;
+std::mutex Metrics::calls_mtx;
+std::thread Metrics::server_thread;
+std::atomic<bool> Metrics::serverStop(false);
+
+static std::string escape_label(const std::string &value) {
+    std::string result;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+void MetricsWriter::gauge(const std::string &name, const std::string &help, const Labels &labels, double value) {
+    add(name, help, "gauge", labels, value);
+}
+
+void MetricsWriter::counter(const std::string &name, const std::string &help, const Labels &labels, double value) {
+    add(name, help, "counter", labels, value);
+}
+
+void MetricsWriter::add(const std::string &name, const std::string &help, const std::string &type,
+                        const Labels &labels, double value) {
+    if (families.find(name) == families.end()) {
+        names.push_back(name);
+        families[name] = {help, type, {}};
+    }
+    std::string sample = name;
+    if (!labels.empty()) {
+        sample += "{";
+        for (size_t i = 0; i < labels.size(); ++i) {
+            sample += (i > 0 ? "," : "") + labels[i].first + "=\"" + escape_label(labels[i].second) + "\"";
+        }
+        sample += "}";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), " %.9g", value);
+    families[name].samples.push_back(sample + buffer);
+}
+
+std::string MetricsWriter::toText() {
+    std::string result;
+    for (auto &name : names) {
+        auto &family = families[name];
+        result += "# HELP " + name + " " + family.help + "\n";
+        result += "# TYPE " + name + " " + family.type + "\n";
+        for (auto &sample : family.samples) {
+            result += sample + "\n";
+        }
+    }
+    return result;
+}
+
+void Metrics::addCollector(const void *owner, const Collector &collector) {
+    std::unique_lock<std::mutex> lock(metrics_mtx);
+    collectors[owner] = collector;
+}
+
+void Metrics::removeCollector(const void *owner) {
+    // Waits for a running collect, the owner can be destroyed afterwards.
+    std::unique_lock<std::mutex> lock(metrics_mtx);
+    collectors.erase(owner);
+}
+
+void Metrics::observeNapiCall(const char *name, uint64_t ns) {
+    std::unique_lock<std::mutex> lock(calls_mtx);
+    auto &stats = napiCalls[name];
+    stats.count++;
+    stats.totalNs += ns;
+    stats.maxNs = std::max(stats.maxNs, ns);
+}
+
+void Metrics::countVolmeterCallback() {
+    volmeterCallbacks++;
+}
+
+uint64_t Metrics::getResidentBytes() {
+#ifdef __linux__
+    long pages = 0;
+    long residentPages = 0;
+    std::ifstream("/proc/self/statm") >> pages >> residentPages;
+    return (uint64_t) residentPages * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+std::string Metrics::collect() {
+    MetricsWriter writer;
+    if (obs_initialized()) {
+        writer.gauge("obs_node_render_frame_time_seconds", "Average time to render a frame", {},
+                     (double) obs_get_average_frame_time_ns() / 1000000000.0);
+        writer.counter("obs_node_frames_total", "Frames rendered", {}, obs_get_total_frames());
+        writer.counter("obs_node_lagged_frames_total", "Frames missed because rendering took too long", {},
+                       obs_get_lagged_frames());
+        video_t *video = obs_get_video();
+        if (video) {
+            writer.counter("obs_node_video_output_frames_total", "Frames of the program video output", {},
+                           video_output_get_total_frames(video));
+            writer.counter("obs_node_video_output_skipped_frames_total",
+                           "Frames skipped by the program video output", {},
+                           video_output_get_skipped_frames(video));
+        }
+    }
+    writer.counter("obs_node_volmeter_callbacks_total", "Volmeter callbacks of all sources", {},
+                   (double) volmeterCallbacks);
+
+    {
+        std::unique_lock<std::mutex> lock(calls_mtx);
+        for (auto &call : napiCalls) {
+            MetricsWriter::Labels labels = {{"function", call.first}};
+            writer.counter("obs_node_napi_calls_total", "N-API calls", labels, (double) call.second.count);
+            writer.counter("obs_node_napi_call_seconds_total", "Time spent in N-API calls", labels,
+                           (double) call.second.totalNs / 1000000000.0);
+            writer.gauge("obs_node_napi_call_max_seconds", "Slowest N-API call", labels,
+                         (double) call.second.maxNs / 1000000000.0);
+        }
+    }
+
+    writer.gauge("obs_node_bmem_allocations", "Live allocations of libobs", {}, bnum_allocs());
+#ifdef __linux__
+    writer.gauge("obs_node_resident_memory_bytes", "Resident memory of the process", {},
+                 (double) getResidentBytes());
+#endif
+
+    std::unique_lock<std::mutex> lock(metrics_mtx);
+    for (auto &collector : collectors) {
+        collector.second(writer);
+    }
+    return writer.toText();
+}
+
+void Metrics::startServer(const std::string &host, int port) {
+    if (server_thread.joinable()) {
+        throw std::logic_error("Metrics server already started");
+    }
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+    socket_t listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket == INVALID_SOCKET_VALUE) {
+        throw std::runtime_error("Failed to create metrics socket");
+    }
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char *) &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        bind(listenSocket, (sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listenSocket, 8) != 0) {
+        CLOSE_SOCKET(listenSocket);
+        throw std::runtime_error("Failed to listen for metrics on " + host + ":" + std::to_string(port));
+    }
+    serverStop = false;
+    server_thread = std::thread(&Metrics::server_callback, (uintptr_t) listenSocket);
+    blog(LOG_INFO, "Metrics server listening on %s:%d", host.c_str(), port);
+}
+
+void Metrics::stopServer() {
+    if (server_thread.joinable()) {
+        serverStop = true;
+        server_thread.join();
+    }
+}
+
+// A stalled client can't hold the server thread longer than this, scrapes
+// after it and stopServer() keep working.
+static void setClientTimeout(socket_t client) {
+#ifdef _WIN32
+    DWORD timeout = CLIENT_TIMEOUT;
+#else
+    timeval timeout = {CLIENT_TIMEOUT / 1000, (CLIENT_TIMEOUT % 1000) * 1000};
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char *) &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout, sizeof(timeout));
+}
+
+void Metrics::server_callback(uintptr_t param) {
+    ThreadPlacement placement(THREAD_CONTROL, "metrics server");
+    auto listenSocket = (socket_t) param;
+    while (!serverStop) {
+        fd_set sockets;
+        FD_ZERO(&sockets);
+        FD_SET(listenSocket, &sockets);
+        timeval timeout = {0, SERVER_POLL_INTERVAL};
+        if (select((int) listenSocket + 1, &sockets, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+        socket_t client = accept(listenSocket, nullptr, nullptr);
+        if (client == INVALID_SOCKET_VALUE) {
+            continue;
+        }
+        setClientTimeout(client);
+
+        // Only the request line matters, scrapers send small GET requests.
+        char request[1024] = {};
+        recv(client, request, sizeof(request) - 1, 0);
+        std::string response;
+        if (std::string(request).rfind("GET /metrics", 0) == 0) {
+            auto body = collect();
+            response = "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                       "Connection: close\r\n\r\n" + body;
+        } else {
+            response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+        size_t sent = 0;
+        while (sent < response.size()) {
+            auto result = send(client, response.data() + sent, (int) (response.size() - sent), 0);
+            if (result <= 0) {
+                break;
+            }
+            sent += result;
+        }
+        CLOSE_SOCKET(client);
+    }
+    CLOSE_SOCKET(listenSocket);
+}
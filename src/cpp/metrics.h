@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Groups samples by metric name, as the Prometheus text format wants one
+// family per name.
+class MetricsWriter {
+
+public:
+    typedef std::vector<std::pair<std::string, std::string>> Labels;
+
+    void gauge(const std::string &name, const std::string &help, const Labels &labels, double value);
+
+    void counter(const std::string &name, const std::string &help, const Labels &labels, double value);
+
+    std::string toText();
+
+private:
+    struct Family {
+        std::string help;
+        std::string type;
+        std::vector<std::string> samples;
+    };
+
+    void add(const std::string &name, const std::string &help, const std::string &type,
+             const Labels &labels, double value);
+
+    std::vector<std::string> names;
+    std::map<std::string, Family> families;
+};
+
+// Process metrics in the Prometheus text format. Values are read when
+// collected, objects with metrics of their own add a collector while they
+// are alive, so a scrape costs nothing between scrapes.
+class Metrics {
+
+public:
+    typedef std::function<void(MetricsWriter &writer)> Collector;
+
+    static void addCollector(const void *owner, const Collector &collector);
+
+    static void removeCollector(const void *owner);
+
+    static void observeNapiCall(const char *name, uint64_t ns);
+
+    static void countVolmeterCallback();
+
+    static std::string collect();
+
+    // Only known on Linux, 0 elsewhere.
+    static uint64_t getResidentBytes();
+
+    // Serves the metrics on http://host:port/metrics from a thread of its own.
+    static void startServer(const std::string &host, int port);
+
+    static void stopServer();
+
+private:
+    struct CallStats {
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+    };
+
+    static void server_callback(uintptr_t listenSocket);
+
+    static std::map<const void *, Collector> collectors;
+    static std::map<std::string, CallStats> napiCalls;
+    static std::atomic<uint64_t> volmeterCallbacks;
+    static std::mutex metrics_mtx;
+    static std::mutex calls_mtx;
+    static std::thread server_thread;
+    static std::atomic<bool> serverStop;
+};
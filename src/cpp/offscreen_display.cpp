@@ -0,0 +1,236 @@
+#include "offscreen_display.h"
+#include "display.h"
+#include "affinity.h"
+#include <algorithm>
+#include <media-io/video-frame.h>
+#include <util/platform.h>
+
+OffscreenDisplay::OffscreenDisplay(std::string &name, const std::vector<std::shared_ptr<SourceHandle>> &handles,
+                                   const OffscreenDisplaySettings &settings, PreviewCache *previewCache) :
+        name(name),
+        settings(settings),
+        previewCache(previewCache),
+        handles(),
+        sources_mtx(),
+        texrender(nullptr),
+        stagesurfaces(),
+        staged_times(),
+        stage_index(0),
+        last_render_time(0),
+        frame(),
+        frame_timestamp(0),
+        frame_count(0),
+        frame_pending(false),
+        frame_mtx(),
+        frame_cv(),
+        video(nullptr),
+        output(nullptr),
+        output_thread(),
+        output_stop(false) {
+    // Frames are also sent to a video output, for the encoded preview stream and frame taps.
+    video_output_info voi = {};
+    std::string videoOutputName = "offscreen_video_output_" + name;
+    voi.name = videoOutputName.c_str();
+    voi.format = VIDEO_FORMAT_BGRA;
+    voi.width = settings.width;
+    voi.height = settings.height;
+    voi.fps_num = settings.fps;
+    voi.fps_den = 1;
+    voi.cache_size = 16;
+    if (video_output_open(&video, &voi) != VIDEO_OUTPUT_SUCCESS) {
+        throw std::runtime_error("Failed to open offscreen display video output");
+    }
+
+    if (settings.output) {
+        output = new Output(name, settings.output, Output::metricsLabels("offscreen_display", "", "", name));
+        try {
+            output->start(video, obs_get_audio());
+        } catch (...) {
+            delete output;
+            output = nullptr;
+            video_output_close(video);
+            video = nullptr;
+            throw;
+        }
+    }
+
+    update(handles);
+    output_thread = std::thread(&OffscreenDisplay::output_callback, this);
+    obs_add_main_render_callback(render_callback, this);
+}
+
+OffscreenDisplay::~OffscreenDisplay() {
+    obs_remove_main_render_callback(render_callback, this);
+    {
+        std::unique_lock<std::mutex> lock(frame_mtx);
+        output_stop = true;
+        frame_cv.notify_all();
+    }
+    if (output_thread.joinable()) {
+        output_thread.join();
+    }
+
+    if (output) {
+        output->stop();
+        delete output;
+        output = nullptr;
+    }
+    if (video) {
+        video_output_stop(video);
+        video_output_close(video);
+        video = nullptr;
+    }
+
+    obs_enter_graphics();
+    for (auto &stagesurface : stagesurfaces) {
+        if (stagesurface) {
+            gs_stagesurface_destroy(stagesurface);
+            stagesurface = nullptr;
+        }
+    }
+    if (texrender) {
+        gs_texrender_destroy(texrender);
+        texrender = nullptr;
+    }
+    obs_leave_graphics();
+
+    std::unique_lock<std::mutex> lock(sources_mtx);
+    clearSources();
+}
+
+void OffscreenDisplay::update(const std::vector<std::shared_ptr<SourceHandle>> &handles) {
+    std::unique_lock<std::mutex> lock(sources_mtx);
+    clearSources();
+    for (const auto &handle : handles) {
+        handle->incShowing();
+        this->handles.push_back(handle);
+    }
+}
+
+void OffscreenDisplay::clearSources() {
+    for (const auto &handle : handles) {
+        handle->decShowing();
+    }
+    handles.clear();
+}
+
+Napi::Value OffscreenDisplay::getFrame(Napi::Env env) {
+    std::unique_lock<std::mutex> lock(frame_mtx);
+    if (frame.empty()) {
+        return env.Null();
+    }
+    auto result = Napi::Object::New(env);
+    result.Set("width", settings.width);
+    result.Set("height", settings.height);
+    result.Set("format", "BGRA");
+    result.Set("timestamp", (double) frame_timestamp);
+    result.Set("data", Napi::Buffer<uint8_t>::Copy(env, frame.data(), frame.size()));
+    return result;
+}
+
+video_t *OffscreenDisplay::getVideo() {
+    return video;
+}
+
+void OffscreenDisplay::render_callback(void *param, uint32_t cx, uint32_t cy) {
+    UNUSED_PARAMETER(cx);
+    UNUSED_PARAMETER(cy);
+    auto *display = (OffscreenDisplay *) param;
+    uint32_t width = display->settings.width;
+    uint32_t height = display->settings.height;
+
+    // Called for every output frame, only render at the display frame rate.
+    uint64_t now = os_gettime_ns();
+    uint64_t interval = 1000000000ULL / display->settings.fps;
+    uint64_t tolerance = obs_get_frame_interval_ns() / 2;
+    if (display->last_render_time && now + tolerance - display->last_render_time < interval) {
+        return;
+    }
+    uint32_t count = display->last_render_time ?
+                     std::max((uint32_t) ((now + tolerance - display->last_render_time) / interval), 1U) : 1;
+    display->last_render_time = now;
+
+    std::vector<obs_source_t *> obs_sources;
+    display->sources_mtx.lock();
+    for (const auto &handle : display->handles) {
+        obs_source_t *obs_source = handle->getRef();
+        if (obs_source) {
+            obs_sources.push_back(obs_source);
+        }
+    }
+    display->sources_mtx.unlock();
+
+    if (!display->texrender) {
+        display->texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+        for (auto &stagesurface : display->stagesurfaces) {
+            stagesurface = gs_stagesurface_create(width, height, GS_BGRA);
+        }
+    }
+
+    gs_texrender_reset(display->texrender);
+    if (gs_texrender_begin(display->texrender, width, height)) {
+        gs_blend_state_push();
+        gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+        vec4 background = {};
+        vec4_zero(&background);
+        gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+        Display::renderMultiview(obs_sources, display->settings.columns, display->previewCache, width, height);
+
+        gs_blend_state_pop();
+        gs_texrender_end(display->texrender);
+
+        gs_stage_texture(display->stagesurfaces[display->stage_index],
+                         gs_texrender_get_texture(display->texrender));
+        display->staged_times[display->stage_index] = now;
+
+        // Map the oldest staged frame, its copy finished while this frame rendered.
+        int map_index = (display->stage_index + 1) % OFFSCREEN_STAGE_SURFACES;
+        display->stage_index = map_index;
+        gs_stagesurf_t *stagesurface = display->stagesurfaces[map_index];
+        uint8_t *data = nullptr;
+        uint32_t linesize;
+        if (display->staged_times[map_index] && gs_stagesurface_map(stagesurface, &data, &linesize)) {
+            std::unique_lock<std::mutex> lock(display->frame_mtx);
+            display->frame.resize((size_t) width * height * 4);
+            for (uint32_t i = 0; i < height; i++) {
+                memcpy(display->frame.data() + (size_t) width * 4 * i, data + (size_t) linesize * i, width * 4);
+            }
+            display->frame_timestamp = display->staged_times[map_index];
+            display->frame_count = display->frame_pending ? display->frame_count + count : count;
+            display->frame_pending = true;
+            display->frame_cv.notify_all();
+            lock.unlock();
+            gs_stagesurface_unmap(stagesurface);
+        }
+    }
+
+    for (auto obs_source : obs_sources) {
+        obs_source_release(obs_source);
+    }
+}
+
+void OffscreenDisplay::output_callback(void *param) {
+    auto *display = (OffscreenDisplay *) param;
+    ThreadPlacement placement(THREAD_RENDER, "offscreen display " + display->name);
+    uint32_t width = display->settings.width;
+    uint32_t height = display->settings.height;
+
+    std::unique_lock<std::mutex> lock(display->frame_mtx);
+    while (true) {
+        display->frame_cv.wait(lock, [display] { return display->output_stop || display->frame_pending; });
+        if (display->output_stop) {
+            break;
+        }
+        display->frame_pending = false;
+        struct video_frame output_frame = {};
+        if (display->video && video_output_lock_frame(display->video, &output_frame, display->frame_count,
+                                                      display->frame_timestamp)) {
+            for (uint32_t i = 0; i < height; i++) {
+                memcpy(output_frame.data[0] + output_frame.linesize[0] * i,
+                       display->frame.data() + (size_t) width * 4 * i, width * 4);
+            }
+            video_output_unlock_frame(display->video);
+        }
+    }
+}
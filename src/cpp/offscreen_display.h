@@ -0,0 +1,65 @@
+#pragma once
+
+#include "settings.h"
+#include "output.h"
+#include "preview_cache.h"
+#include "source_handle.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <obs.h>
+#include <graphics/graphics.h>
+
+#define OFFSCREEN_STAGE_SURFACES 2
+
+// A display without a native window, for headless servers. It renders the
+// multiview of its sources into a texture at its own frame rate in the
+// graphics thread, keeps the last frame for readback, and optionally encodes
+// it as a preview stream. Frames are sent to the video output from a thread
+// of its own, so the graphics thread never waits for the encoders.
+class OffscreenDisplay {
+
+public:
+    OffscreenDisplay(std::string &name, const std::vector<std::shared_ptr<SourceHandle>> &handles,
+                     const OffscreenDisplaySettings &settings, PreviewCache *previewCache);
+
+    ~OffscreenDisplay();
+
+    void update(const std::vector<std::shared_ptr<SourceHandle>> &handles);
+
+    Napi::Value getFrame(Napi::Env env);
+
+    video_t *getVideo();
+
+private:
+    static void render_callback(void *param, uint32_t cx, uint32_t cy);
+    static void output_callback(void *param);
+
+    void clearSources();
+
+    std::string name;
+    OffscreenDisplaySettings settings;
+    PreviewCache *previewCache;
+    std::vector<std::shared_ptr<SourceHandle>> handles;
+    std::mutex sources_mtx;
+
+    gs_texrender_t *texrender;
+    // Frames are read back one frame late, so mapping never waits for the GPU.
+    gs_stagesurf_t *stagesurfaces[OFFSCREEN_STAGE_SURFACES];
+    uint64_t staged_times[OFFSCREEN_STAGE_SURFACES];
+    int stage_index;
+    uint64_t last_render_time;
+    std::vector<uint8_t> frame;
+    uint64_t frame_timestamp;
+    uint32_t frame_count; // Video output frames since the previous frame
+    bool frame_pending; // Not sent to the video output yet
+    std::mutex frame_mtx;
+    std::condition_variable frame_cv;
+
+    video_t *video;
+    Output *output;
+
+    std::thread output_thread;
+    bool output_stop;
+};
@@ -1,14 +1,53 @@
 #include "output.h"
 #include "studio.h"
+#include "callback.h"
+#include "affinity.h"
+#include "encoder_budget.h"
+#include "trace.h"
+#include <algorithm>
 #include <utility>
+#include <util/platform.h>
 
-Output::Output(std::shared_ptr<OutputSettings> settings) :
+#define MONITOR_INTERVAL 1000 // milliseconds
+#define CONGESTION_HIGH 0.5f
+#define CONGESTION_LOW 0.1f
+#define BITRATE_DECREASE_PERCENT 70
+#define BITRATE_INCREASE_PERCENT 10 // of max bitrate
+#define BITRATE_INCREASE_STABLE_COUNT 5 // intervals without congestion before increasing
+#define REPLAY_SAVE_TIMEOUT 10000 // milliseconds
+
+MetricsWriter::Labels Output::metricsLabels(const std::string &kind, const std::string &sceneId,
+                                           const std::string &sourceId, const std::string &outputId) {
+    return {{"kind", kind}, {"scene", sceneId}, {"source", sourceId}, {"output", outputId}};
+}
+
+Output::Output(const std::string &id, std::shared_ptr<OutputSettings> settings, MetricsWriter::Labels labels) :
+        id(id),
         settings(std::move(settings)),
+        labels(std::move(labels)),
         video_encoder(nullptr),
         audio_encoders(),
         output_service(nullptr),
         output(nullptr),
-        record_output(nullptr) {
+        record_output(nullptr),
+        record_writer(nullptr),
+        segment_output(nullptr),
+        replay_output(nullptr),
+        packet_output(nullptr),
+        videoBitrateKbps(0),
+        measuredBitrateKbps(0),
+        recordBitrateKbps(0),
+        reconnectCount(0),
+        reconnectAttempt(0),
+        reconnectTime(0),
+        monitor_thread(),
+        monitor_mtx(),
+        monitor_cv(),
+        monitor_stop(false),
+        replayCallback(),
+        replayPath(),
+        replayDeadline(0),
+        replay_mtx() {
 }
 
 std::shared_ptr<OutputSettings> Output::getSettings() {
@@ -19,7 +58,17 @@ void Output::start(video_t *video, audio_t *audio) {
     if (!settings) {
         return;
     }
+    TRACE_SCOPE("Output::start");
+    try {
+        startOutputs(video, audio);
+    } catch (...) {
+        // The live output may be running already, never leave it without a handle.
+        stop();
+        throw;
+    }
+}
 
+void Output::startOutputs(video_t *video, audio_t *audio) {
     // video encoder
     obs_data_t *video_encoder_settings = obs_data_create();
     obs_data_set_int(video_encoder_settings, "keyint_sec", settings->keyintSec);
@@ -29,12 +78,30 @@ void Output::start(video_t *video, audio_t *audio) {
     obs_data_set_string(video_encoder_settings, "preset", settings->preset.c_str());
     obs_data_set_string(video_encoder_settings, "profile", settings->profile.c_str());
     obs_data_set_string(video_encoder_settings, "tune", settings->tune.c_str());
-    obs_data_set_string(video_encoder_settings, "x264opts", settings->x264opts.c_str());
+    if (settings->videoEncoder == "obs_x264") {
+        auto x264opts = EncoderBudget::acquire(this, settings->width, settings->height, settings->x264opts);
+        obs_data_set_string(video_encoder_settings, "x264opts", x264opts.c_str());
+    } else {
+        obs_data_set_string(video_encoder_settings, "x264opts", settings->x264opts.c_str());
+    }
     obs_data_set_int(video_encoder_settings, "bitrate", settings->videoBitrateKbps);
-    video_encoder = obs_video_encoder_create(settings->hardwareEnable ? "ffmpeg_nvenc" : "obs_x264", "h264 enc", video_encoder_settings, nullptr);
+    if (!settings->videoEncoderSettingsJson.empty()) {
+        // Encoder specific settings go through as is, over the common ones.
+        obs_data_t *encoder_specific_settings = obs_data_create_from_json(settings->videoEncoderSettingsJson.c_str());
+        obs_data_apply(video_encoder_settings, encoder_specific_settings);
+        obs_data_release(encoder_specific_settings);
+    }
+    video_encoder = obs_video_encoder_create(settings->videoEncoder.c_str(), "video enc", video_encoder_settings, nullptr);
+    if (!video_encoder) {
+        throw std::runtime_error("Failed to create video encoder: " + settings->videoEncoder);
+    }
 
     obs_encoder_set_scaled_size(video_encoder, settings->width, settings->height);
     obs_encoder_set_video(video_encoder, video);
+    if (settings->dynamicBitrate && !(obs_encoder_get_caps(video_encoder) & OBS_ENCODER_CAP_DYN_BITRATE)) {
+        blog(LOG_WARNING, "[%s] encoder %s can't change bitrate while running, dynamic bitrate is disabled",
+             id.c_str(), settings->videoEncoder.c_str());
+    }
 
     // audio encoder
     if (settings->mixers < 1 || settings->mixers > MAX_AUDIO_MIXES) {
@@ -60,7 +127,8 @@ void Output::start(video_t *video, audio_t *audio) {
         server = settings->url.substr(0, index);
         key = settings->url.substr(index + 1);
     } else {
-        server = settings->url;
+        // srt:// and other urls go to the mpegts muxer, with the SRT options in the url.
+        server = settings->srt.apply(settings->url);
     }
 
     obs_data_t *output_service_settings = obs_data_create();
@@ -108,20 +176,44 @@ void Output::start(video_t *video, audio_t *audio) {
 
     obs_output_set_service(output, output_service);
 
-    // delay
+    // delay, the delayed data is kept when the output is restarted by reconnecting
     if (settings->delaySec >= 0) {
-        obs_output_set_delay(output, settings->delaySec, 0);
+        obs_output_set_delay(output, settings->delaySec, settings->autoReconnect ? OBS_OUTPUT_DELAY_PRESERVE : 0);
+    }
+
+    // Our own reconnect replaces the built-in one, which stops and restarts the encoders.
+    if (settings->autoReconnect) {
+        obs_output_set_reconnect_settings(output, 0, 0);
     }
 
-    if (!obs_output_start(output)) {
+    signal_handler_t *handler = obs_output_get_signal_handler(output);
+    signal_handler_connect(handler, "reconnect", output_reconnect_callback, this);
+    signal_handler_connect(handler, "start", output_start_callback, this);
+    signal_handler_connect(handler, "stop", output_stop_callback, this);
+
+    // The encoders are initialized by the first output, their threads inherit its core set.
+    bool started;
+    {
+        ScopedAffinity affinity(settings->encoderCores.empty() ?
+                                Affinity::getCores(THREAD_ENCODER) : parseCoreSet(settings->encoderCores));
+        started = obs_output_start(output);
+    }
+    if (!started) {
         throw std::runtime_error("Failed to start output.");
     }
 
     // record
-    if (settings->recordEnable) {
-        if (settings->recordFilePath.empty()) {
-            throw std::runtime_error("Record file path can't be empty");
-        }
+    if (settings->recordEnable && settings->recordFilePath.empty()) {
+        throw std::runtime_error("Record file path can't be empty");
+    }
+    if (settings->recordEnable && settings->recordWriter == "native") {
+        // Written in process, a slow disk only fills the write-ahead buffer.
+        record_writer = new RecordWriter(id, settings->recordFilePath, video_encoder, audio_encoders[0],
+                                         (size_t) settings->recordBufferMb * 1024 * 1024,
+                                         RecordWriter::getFsyncPolicy(settings->recordFsync),
+                                         settings->recordFsyncIntervalMs);
+        record_writer->start();
+    } else if (settings->recordEnable) {
         obs_data_t *recorder_settings = obs_data_create();
         obs_data_set_string(recorder_settings, "path", settings->recordFilePath.c_str());
         obs_data_set_string(recorder_settings, "muxer_settings", "movflags=frag_keyframe min_frag_duration=4000000");
@@ -143,26 +235,452 @@ void Output::start(video_t *video, audio_t *audio) {
         }
     }
 
+    // segmented recording, muxed from the same encoder packets as the live output
+    if (settings->segment) {
+        obs_data_t *segment_settings = obs_data_create();
+        obs_data_set_string(segment_settings, "path", settings->segment->path.c_str());
+        obs_data_set_string(segment_settings, "muxer_settings", settings->segment->getMuxerSettings().c_str());
+#ifdef _WIN32
+        obs_data_set_string(segment_settings, "exec_path", (Studio::getObsBinPath() + "\\obs-ffmpeg-mux.exe").c_str());
+#else
+        obs_data_set_string(segment_settings, "exec_path", (Studio::getObsBinPath() + "/obs-ffmpeg-mux").c_str());
+#endif
+        segment_output = obs_output_create("ffmpeg_muxer", "segment_output", segment_settings, nullptr);
+        obs_data_release(segment_settings);
+        if (!segment_output) {
+            throw std::runtime_error("Failed to create segment output");
+        }
+        obs_output_set_video_encoder(segment_output, video_encoder);
+        for (size_t i = 0; i < audio_encoders.size(); ++i) {
+            obs_output_set_audio_encoder(segment_output, audio_encoders[i], i);
+        }
+        if (!obs_output_start(segment_output)) {
+            throw std::runtime_error("Failed to start segment output");
+        }
+    }
+
+    // replay buffer, keeps the last replaySec of encoded packets in memory
+    if (settings->replaySec > 0) {
+        obs_data_t *replay_settings = obs_data_create();
+        obs_data_set_int(replay_settings, "max_time_sec", settings->replaySec);
+        obs_data_set_int(replay_settings, "max_size_mb", settings->replayMaxMemoryMb);
+#ifdef _WIN32
+        obs_data_set_string(replay_settings, "exec_path", (Studio::getObsBinPath() + "\\obs-ffmpeg-mux.exe").c_str());
+#else
+        obs_data_set_string(replay_settings, "exec_path", (Studio::getObsBinPath() + "/obs-ffmpeg-mux").c_str());
+#endif
+        replay_output = obs_output_create("replay_buffer", "replay_output", replay_settings, nullptr);
+        obs_data_release(replay_settings);
+        if (!replay_output) {
+            throw std::runtime_error("Failed to create replay output");
+        }
+        obs_output_set_video_encoder(replay_output, video_encoder);
+        for (size_t i = 0; i < audio_encoders.size(); ++i) {
+            obs_output_set_audio_encoder(replay_output, audio_encoders[i], i);
+        }
+        signal_handler_connect(obs_output_get_signal_handler(replay_output), "saved", replay_saved_callback, this);
+        if (!obs_output_start(replay_output)) {
+            throw std::runtime_error("Failed to start replay output");
+        }
+    }
+
     // enable absolute timestamp
     if (settings->enableAbsoluteTimestamp) {
         obs_output_set_enable_absolute_timestamp(output, true);
     }
+
+    // Packets of the same encoders, to measure the encoder latency. It also keeps
+    // the encoders running while the output is reconnecting.
+    packet_output = new PacketOutput(id, video_encoder, audio_encoders);
+    packet_output->setReplayWindow(settings->replaySec, (int64_t) settings->replayMaxMemoryMb * 1024 * 1024);
+    packet_output->start();
+
+    videoBitrateKbps = settings->videoBitrateKbps;
+    monitor_thread = std::thread(&Output::monitor_callback, this);
+    Metrics::addCollector(this, [this](MetricsWriter &writer) {
+        collectMetrics(writer);
+    });
 }
 
 void Output::stop() {
+    TRACE_SCOPE("Output::stop");
+    Metrics::removeCollector(this);
+    if (monitor_thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(monitor_mtx);
+            monitor_stop = true;
+        }
+        monitor_cv.notify_one();
+        monitor_thread.join();
+    }
+    if (packet_output) {
+        delete packet_output;
+        packet_output = nullptr;
+    }
+    if (record_writer) {
+        delete record_writer;
+        record_writer = nullptr;
+    }
+    EncoderBudget::release(this);
     if (output) {
+        signal_handler_t *handler = obs_output_get_signal_handler(output);
+        signal_handler_disconnect(handler, "reconnect", output_reconnect_callback, this);
+        signal_handler_disconnect(handler, "start", output_start_callback, this);
+        signal_handler_disconnect(handler, "stop", output_stop_callback, this);
         obs_output_stop(output);
-        if (record_output) {
-            obs_output_stop(record_output);
+        obs_output_release(output);
+        output = nullptr;
+    }
+    if (record_output) {
+        obs_output_stop(record_output);
+        obs_output_release(record_output);
+        record_output = nullptr;
+    }
+    if (segment_output) {
+        obs_output_stop(segment_output);
+        obs_output_release(segment_output);
+        segment_output = nullptr;
+    }
+    if (replay_output) {
+        signal_handler_disconnect(obs_output_get_signal_handler(replay_output), "saved", replay_saved_callback, this);
+        obs_output_stop(replay_output);
+        finishReplay(false, "Output stopped before the replay was saved");
+        obs_output_release(replay_output);
+        replay_output = nullptr;
+    }
+    obs_encoder_release(video_encoder);
+    video_encoder = nullptr;
+    for (auto & audio_encoder : audio_encoders) {
+        obs_encoder_release(audio_encoder);
+    }
+    audio_encoders.clear();
+    obs_service_release(output_service);
+    output_service = nullptr;
+}
+
+Napi::Object Output::getStats(Napi::Env env) {
+    auto result = Napi::Object::New(env);
+    result.Set("active", output && obs_output_active(output));
+    if (!output) {
+        return result;
+    }
+    result.Set("bytesSent", (double) obs_output_get_total_bytes(output));
+    result.Set("bitrateKbps", (int) measuredBitrateKbps);
+    result.Set("videoBitrateKbps", (int) videoBitrateKbps);
+    result.Set("totalFrames", obs_output_get_total_frames(output));
+    result.Set("networkDroppedFrames", obs_output_get_frames_dropped(output));
+    // The program video is shared by all studio outputs, its skipped frames
+    // are only in the global metrics.
+    video_t *video = obs_encoder_video(video_encoder);
+    if (video && video != obs_get_video()) {
+        result.Set("videoSkippedFrames", video_output_get_skipped_frames(video));
+    }
+    result.Set("congestion", obs_output_get_congestion(output));
+    result.Set("connectTimeMs", obs_output_get_connect_time_ms(output));
+    result.Set("reconnectCount", (int) reconnectCount);
+    result.Set("encoderLatencyMs", packet_output ? packet_output->getEncoderLatencyMs() : 0.0);
+    if (record_output) {
+        auto record = Napi::Object::New(env);
+        record.Set("active", obs_output_active(record_output));
+        record.Set("bytesWritten", (double) obs_output_get_total_bytes(record_output));
+        record.Set("bitrateKbps", (int) recordBitrateKbps);
+        record.Set("totalFrames", obs_output_get_total_frames(record_output));
+        record.Set("droppedFrames", obs_output_get_frames_dropped(record_output));
+        result.Set("record", record);
+    }
+    if (record_writer) {
+        auto record = Napi::Object::New(env);
+        record.Set("active", record_writer->isActive());
+        record.Set("bytesWritten", (double) record_writer->getBytesWritten());
+        record.Set("bitrateKbps", (int) recordBitrateKbps);
+        record.Set("bufferedBytes", (double) record_writer->getBufferedBytes());
+        record.Set("droppedPackets", record_writer->getDroppedPackets());
+        result.Set("record", record);
+    }
+    if (segment_output) {
+        auto segment = Napi::Object::New(env);
+        segment.Set("active", obs_output_active(segment_output));
+        segment.Set("bytesWritten", (double) obs_output_get_total_bytes(segment_output));
+        segment.Set("totalFrames", obs_output_get_total_frames(segment_output));
+        segment.Set("droppedFrames", obs_output_get_frames_dropped(segment_output));
+        result.Set("segment", segment);
+    }
+    if (replay_output) {
+        auto replay = Napi::Object::New(env);
+        replay.Set("active", obs_output_active(replay_output));
+        replay.Set("bufferedSec", packet_output ? packet_output->getReplaySec() : 0.0);
+        replay.Set("memoryBytes", packet_output ? (double) packet_output->getReplayBytes() : 0.0);
+        replay.Set("maxSec", settings->replaySec);
+        replay.Set("maxMemoryMb", settings->replayMaxMemoryMb);
+        replay.Set("lastReplayPath", getLastReplayPath());
+        result.Set("replay", replay);
+    }
+    return result;
+}
+
+void Output::collectMetrics(MetricsWriter &writer) {
+    writer.gauge("obs_node_output_active", "Whether the output is sending", labels, obs_output_active(output));
+    writer.counter("obs_node_output_bytes_total", "Bytes sent by the output", labels,
+                   (double) obs_output_get_total_bytes(output));
+    writer.gauge("obs_node_output_bitrate_kbps", "Bitrate sent in the last second", labels, measuredBitrateKbps);
+    writer.gauge("obs_node_output_video_bitrate_kbps", "Video encoder bitrate setting", labels, videoBitrateKbps);
+    writer.counter("obs_node_output_frames_total", "Frames sent by the output", labels,
+                   obs_output_get_total_frames(output));
+    writer.counter("obs_node_output_dropped_frames_total", "Frames dropped by the network", labels,
+                   obs_output_get_frames_dropped(output));
+    writer.gauge("obs_node_output_congestion", "Output congestion between 0 and 1", labels,
+                 obs_output_get_congestion(output));
+    writer.counter("obs_node_output_reconnects_total", "Output reconnections", labels, reconnectCount);
+    video_t *video = obs_encoder_video(video_encoder);
+    if (video && video != obs_get_video()) {
+        writer.counter("obs_node_output_video_skipped_frames_total", "Frames skipped by the output's own video",
+                       labels, video_output_get_skipped_frames(video));
+    }
+    if (packet_output) {
+        writer.gauge("obs_node_output_encoder_latency_seconds", "Time from raw frame to encoded packet", labels,
+                     packet_output->getEncoderLatencyMs() / 1000.0);
+        if (replay_output) {
+            writer.gauge("obs_node_output_replay_memory_bytes", "Memory held by the replay buffer", labels,
+                         (double) packet_output->getReplayBytes());
+        }
+    }
+    if (record_writer) {
+        writer.gauge("obs_node_output_record_buffered_bytes", "Bytes waiting to be written to disk", labels,
+                     (double) record_writer->getBufferedBytes());
+        writer.counter("obs_node_output_record_dropped_packets_total", "Packets dropped by a full record buffer",
+                       labels, record_writer->getDroppedPackets());
+    }
+}
+
+uint64_t Output::getRecordBytes() {
+    if (record_writer) {
+        return record_writer->getBytesWritten();
+    }
+    return record_output ? obs_output_get_total_bytes(record_output) : 0;
+}
+
+void Output::saveReplay(const std::string &path, ReplayCallback callback) {
+    if (!replay_output || !obs_output_active(replay_output)) {
+        throw std::logic_error("Replay buffer of output: " + id + " isn't running");
+    }
+    auto slash = path.find_last_of("/\\");
+    auto dot = path.rfind('.');
+    if (slash == std::string::npos || dot == std::string::npos || dot < slash) {
+        throw std::invalid_argument("Replay path should be a file path with extension: " + path);
+    }
+    if (path.find('%') != std::string::npos) {
+        throw std::invalid_argument("Replay path can't contain '%': " + path);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(replay_mtx);
+        if (replayCallback) {
+            throw std::logic_error("A replay of output: " + id + " is being saved");
         }
-        obs_encoder_release(video_encoder);
-        for (auto & audio_encoder : audio_encoders) {
-            obs_encoder_release(audio_encoder);
+        // Packets are muxed without re-encoding, the callback runs once the file can be played.
+        replayCallback = std::move(callback);
+        replayPath = path;
+        replayDeadline = os_gettime_ns() + REPLAY_SAVE_TIMEOUT * 1000000ULL;
+    }
+
+    // The replay buffer builds the file name from directory, format and extension when saving.
+    obs_data_t *replay_settings = obs_data_create();
+    obs_data_set_string(replay_settings, "directory", path.substr(0, slash).c_str());
+    obs_data_set_string(replay_settings, "format", path.substr(slash + 1, dot - slash - 1).c_str());
+    obs_data_set_string(replay_settings, "extension", path.substr(dot + 1).c_str());
+    obs_data_set_bool(replay_settings, "allow_spaces", true);
+    obs_output_update(replay_output, replay_settings);
+    obs_data_release(replay_settings);
+
+    calldata_t cd = {};
+    proc_handler_call(obs_output_get_proc_handler(replay_output), "save", &cd);
+    calldata_free(&cd);
+}
+
+// Runs the pending replay callback, with the saved path when there is no error.
+// expiredOnly leaves a save that is still within its timeout alone.
+void Output::finishReplay(bool expiredOnly, const std::string &error) {
+    ReplayCallback callback;
+    std::string path;
+    {
+        std::unique_lock<std::mutex> lock(replay_mtx);
+        if (!replayCallback || (expiredOnly && os_gettime_ns() < replayDeadline)) {
+            return;
         }
-        obs_output_release(output);
-        obs_service_release(output_service);
-        if (record_output) {
-            obs_output_release(record_output);
+        callback = std::move(replayCallback);
+        replayCallback = nullptr;
+        path = replayPath;
+    }
+    if (error.empty()) {
+        callback(getLastReplayPath(), "");
+    } else {
+        callback("", error + ": " + path);
+    }
+}
+
+std::string Output::getLastReplayPath() {
+    if (!replay_output) {
+        return "";
+    }
+    std::string result;
+    calldata_t cd = {};
+    proc_handler_call(obs_output_get_proc_handler(replay_output), "get_last_replay", &cd);
+    const char *path = calldata_string(&cd, "path");
+    if (path) {
+        result = path;
+    }
+    calldata_free(&cd);
+    return result;
+}
+
+void Output::replay_saved_callback(void *param, calldata_t *data) {
+    UNUSED_PARAMETER(data);
+    ((Output *) param)->finishReplay(false, "");
+}
+
+void Output::output_start_callback(void *param, calldata_t *data) {
+    UNUSED_PARAMETER(data);
+    auto *o = (Output *) param;
+    std::unique_lock<std::mutex> lock(o->monitor_mtx);
+    if (o->reconnectAttempt > 0) {
+        o->reconnectCount++;
+        o->reconnectAttempt = 0;
+        blog(LOG_INFO, "[%s] output reconnected, count: %d", o->id.c_str(), (int) o->reconnectCount);
+    }
+}
+
+void Output::output_stop_callback(void *param, calldata_t *data) {
+    auto *o = (Output *) param;
+    auto code = (int) calldata_int(data, "code");
+    if (code != OBS_OUTPUT_SUCCESS) {
+        blog(LOG_WARNING, "[%s] output stopped, code: %d", o->id.c_str(), code);
+        o->scheduleReconnect();
+    }
+}
+
+void Output::scheduleReconnect() {
+    {
+        std::unique_lock<std::mutex> lock(monitor_mtx);
+        if (!settings->autoReconnect || monitor_stop) {
+            return;
+        }
+        if (settings->reconnectMaxRetries > 0 && reconnectAttempt >= settings->reconnectMaxRetries) {
+            blog(LOG_ERROR, "[%s] give up reconnecting after %d attempts", id.c_str(), reconnectAttempt);
+            return;
+        }
+        // Exponential backoff: delay, 2 * delay, 4 * delay ... up to the max delay.
+        uint64_t delayMs = (uint64_t) settings->reconnectDelayMs << std::min(reconnectAttempt, 16);
+        delayMs = std::min(delayMs, (uint64_t) settings->reconnectMaxDelayMs);
+        reconnectAttempt++;
+        reconnectTime = os_gettime_ns() + delayMs * 1000000ULL;
+        blog(LOG_INFO, "[%s] reconnect in %llu ms", id.c_str(), (unsigned long long) delayMs);
+    }
+    monitor_cv.notify_one();
+}
+
+void Output::output_reconnect_callback(void *param, calldata_t *data) {
+    UNUSED_PARAMETER(data);
+    auto *o = (Output *) param;
+    o->reconnectCount++;
+    blog(LOG_INFO, "[%s] output reconnecting, count: %d", o->id.c_str(), (int) o->reconnectCount);
+}
+
+void Output::monitor_callback(void *param) {
+    auto *o = (Output *) param;
+    ThreadPlacement placement(THREAD_OUTPUT, "output monitor " + o->id, o->settings->threadCores);
+    int lastDropped = obs_output_get_frames_dropped(o->output);
+    uint64_t lastBytes = obs_output_get_total_bytes(o->output);
+    uint64_t lastRecordBytes = o->getRecordBytes();
+    uint64_t lastTime = os_gettime_ns();
+    int stableCount = 0;
+
+    while (true) {
+        bool reconnect = false;
+        {
+            std::unique_lock<std::mutex> lock(o->monitor_mtx);
+            uint64_t waitNs = MONITOR_INTERVAL * 1000000ULL;
+            if (o->reconnectTime) {
+                uint64_t now = os_gettime_ns();
+                waitNs = o->reconnectTime > now ? std::min(waitNs, o->reconnectTime - now) : 0;
+            }
+            o->monitor_cv.wait_for(lock, std::chrono::nanoseconds(waitNs));
+            if (o->monitor_stop) {
+                break;
+            }
+            if (o->reconnectTime && o->reconnectTime <= os_gettime_ns()) {
+                o->reconnectTime = 0;
+                reconnect = true;
+            }
+        }
+        o->finishReplay(true, "Timeout to save replay");
+
+        // Restart the stopped output, the encoders are kept running by the packet output.
+        if (reconnect) {
+            blog(LOG_INFO, "[%s] reconnect output, attempt: %d", o->id.c_str(), o->reconnectAttempt);
+            if (!obs_output_start(o->output)) {
+                o->scheduleReconnect();
+            }
+            continue;
+        }
+
+        // Throughput in the last interval
+        uint64_t now = os_gettime_ns();
+        uint64_t elapsedMs = std::max((now - lastTime) / 1000000, (uint64_t) 1);
+        uint64_t bytes = obs_output_get_total_bytes(o->output);
+        o->measuredBitrateKbps = (int) ((bytes - std::min(bytes, lastBytes)) * 8 / elapsedMs);
+        lastBytes = bytes;
+        if (o->record_output || o->record_writer) {
+            uint64_t recordBytes = o->getRecordBytes();
+            o->recordBitrateKbps = (int) ((recordBytes - std::min(recordBytes, lastRecordBytes)) * 8 / elapsedMs);
+            lastRecordBytes = recordBytes;
+        }
+        lastTime = now;
+
+        float congestion = obs_output_get_congestion(o->output);
+        int dropped = obs_output_get_frames_dropped(o->output);
+        int newDropped = dropped - lastDropped;
+        lastDropped = dropped;
+
+        if (o->settings->dynamicBitrate && (obs_encoder_get_caps(o->video_encoder) & OBS_ENCODER_CAP_DYN_BITRATE)) {
+            o->adaptVideoBitrate(congestion, newDropped, stableCount);
         }
     }
 }
+
+void Output::adaptVideoBitrate(float congestion, int newDropped, int &stableCount) {
+    int minBitrate = settings->minVideoBitrateKbps;
+    int maxBitrate = settings->maxVideoBitrateKbps;
+
+    // Step down fast on congestion, step up slowly after the link is stable for a while.
+    int previousBitrate = videoBitrateKbps;
+    int bitrate = previousBitrate;
+    if (newDropped > 0 || congestion > CONGESTION_HIGH) {
+        bitrate = std::max(minBitrate, previousBitrate * BITRATE_DECREASE_PERCENT / 100);
+        stableCount = 0;
+    } else if (congestion < CONGESTION_LOW) {
+        if (++stableCount >= BITRATE_INCREASE_STABLE_COUNT) {
+            bitrate = std::min(maxBitrate, previousBitrate + maxBitrate * BITRATE_INCREASE_PERCENT / 100);
+            stableCount = 0;
+        }
+    } else {
+        stableCount = 0;
+    }
+
+    if (bitrate != previousBitrate) {
+        blog(LOG_INFO, "[%s] change video bitrate %d -> %d kbps, congestion: %.2f, dropped frames: %d",
+             id.c_str(), previousBitrate, bitrate, congestion, newDropped);
+        setVideoBitrate(bitrate);
+        auto callback = Callback::getBitrateCallback();
+        if (callback) {
+            callback(id, bitrate, previousBitrate, congestion, newDropped);
+        }
+    }
+}
+
+void Output::setVideoBitrate(int bitrateKbps) {
+    obs_data_t *video_encoder_settings = obs_encoder_get_settings(video_encoder);
+    obs_data_set_int(video_encoder_settings, "bitrate", bitrateKbps);
+    obs_encoder_update(video_encoder, video_encoder_settings);
+    obs_data_release(video_encoder_settings);
+    videoBitrateKbps = bitrateKbps;
+}
@@ -1,21 +1,78 @@
 #pragma once
 #include <obs.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include "settings.h"
+#include "packet_output.h"
+#include "record_writer.h"
+#include "metrics.h"
 
 class Output {
 
 public:
-    explicit Output(std::shared_ptr<OutputSettings> settings);
+    // Called with the path of the saved replay, or with an error.
+    typedef std::function<void(const std::string &path, const std::string &error)> ReplayCallback;
+
+    // Outputs of studio, sources and offscreen displays share ids, the labels
+    // tell their metrics apart.
+    static MetricsWriter::Labels metricsLabels(const std::string &kind, const std::string &sceneId,
+                                               const std::string &sourceId, const std::string &outputId);
+
+    Output(const std::string &id, std::shared_ptr<OutputSettings> settings, MetricsWriter::Labels labels);
 
     std::shared_ptr<OutputSettings> getSettings();
+    // Stops whatever it started before throwing, the output can then be deleted.
     void start(video_t *video, audio_t *audio);
     void stop();
+    Napi::Object getStats(Napi::Env env);
+    void saveReplay(const std::string &path, ReplayCallback callback);
+    std::string getLastReplayPath();
 
 private:
+    void startOutputs(video_t *video, audio_t *audio);
+    static void monitor_callback(void *param);
+    static void output_reconnect_callback(void *param, calldata_t *data);
+    static void output_start_callback(void *param, calldata_t *data);
+    static void output_stop_callback(void *param, calldata_t *data);
+    static void replay_saved_callback(void *param, calldata_t *data);
+    void scheduleReconnect();
+    void adaptVideoBitrate(float congestion, int newDropped, int &stableCount);
+    void setVideoBitrate(int bitrateKbps);
+    uint64_t getRecordBytes();
+    void collectMetrics(MetricsWriter &writer);
+    void finishReplay(bool expiredOnly, const std::string &error);
+
+    std::string id;
     std::shared_ptr<OutputSettings> settings;
+    MetricsWriter::Labels labels;
     obs_encoder_t *video_encoder;
     std::vector<obs_encoder_t *> audio_encoders;
     obs_service_t *output_service;
     obs_output_t *output;
     obs_output_t *record_output;
+    RecordWriter *record_writer;
+    obs_output_t *segment_output;
+    obs_output_t *replay_output;
+    PacketOutput *packet_output;
+
+    // Monitoring and dynamic bitrate
+    std::atomic<int> videoBitrateKbps;
+    std::atomic<int> measuredBitrateKbps;
+    std::atomic<int> recordBitrateKbps;
+    std::atomic<int> reconnectCount;
+    int reconnectAttempt;
+    uint64_t reconnectTime;
+    std::thread monitor_thread;
+    std::mutex monitor_mtx;
+    std::condition_variable monitor_cv;
+    bool monitor_stop;
+
+    // Replay buffer, one save at a time
+    ReplayCallback replayCallback;
+    std::string replayPath;
+    uint64_t replayDeadline;
+    std::mutex replay_mtx;
 };
\ No newline at end of file
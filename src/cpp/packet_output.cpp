@@ -0,0 +1,146 @@
+#include "packet_output.h"
+#include <util/platform.h>
+
+#define PACKET_OUTPUT_ID "obs_node_packet_output"
+
+void PacketOutput::registerOutput() {
+    obs_output_info info = {};
+    info.id = PACKET_OUTPUT_ID;
+    info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_MULTI_TRACK;
+    info.get_name = output_get_name;
+    info.create = output_create;
+    info.destroy = output_destroy;
+    info.start = output_start;
+    info.stop = output_stop;
+    info.encoded_packet = output_encoded_packet;
+    obs_register_output(&info);
+}
+
+PacketOutput::PacketOutput(const std::string &name, obs_encoder_t *video_encoder,
+                           const std::vector<obs_encoder_t *> &audio_encoders) :
+        name(name),
+        output(nullptr),
+        encoderLatencyUs(0),
+        videoPackets(0),
+        replayPackets(),
+        replayBytes(0),
+        replayMaxSec(0),
+        replayMaxBytes(0),
+        replay_mtx() {
+    // The output finds this object through its settings.
+    obs_data_t *settings = obs_data_create();
+    obs_data_set_int(settings, "owner", (long long) this);
+    output = obs_output_create(PACKET_OUTPUT_ID, (name + "_packets").c_str(), settings, nullptr);
+    obs_data_release(settings);
+    if (!output) {
+        throw std::runtime_error("Failed to create packet output.");
+    }
+    obs_output_set_video_encoder(output, video_encoder);
+    for (size_t i = 0; i < audio_encoders.size(); ++i) {
+        obs_output_set_audio_encoder(output, audio_encoders[i], i);
+    }
+}
+
+PacketOutput::~PacketOutput() {
+    stop();
+    obs_output_release(output);
+}
+
+void PacketOutput::start() {
+    if (!obs_output_start(output)) {
+        throw std::runtime_error("Failed to start packet output.");
+    }
+}
+
+void PacketOutput::stop() {
+    if (obs_output_active(output)) {
+        obs_output_stop(output);
+    }
+}
+
+double PacketOutput::getEncoderLatencyMs() {
+    return (double) encoderLatencyUs / 1000.0;
+}
+
+int PacketOutput::getVideoPackets() {
+    return videoPackets;
+}
+
+void PacketOutput::setReplayWindow(int maxSec, int64_t maxBytes) {
+    std::unique_lock<std::mutex> lock(replay_mtx);
+    replayMaxSec = maxSec;
+    replayMaxBytes = maxBytes;
+}
+
+int64_t PacketOutput::getReplayBytes() {
+    std::unique_lock<std::mutex> lock(replay_mtx);
+    return replayBytes;
+}
+
+double PacketOutput::getReplaySec() {
+    std::unique_lock<std::mutex> lock(replay_mtx);
+    if (replayPackets.empty()) {
+        return 0;
+    }
+    return (double) (replayPackets.back().dtsUsec - replayPackets.front().dtsUsec) / 1000000.0;
+}
+
+const char *PacketOutput::output_get_name(void *type_data) {
+    UNUSED_PARAMETER(type_data);
+    return "obs-node packet output";
+}
+
+void *PacketOutput::output_create(obs_data_t *settings, obs_output_t *output) {
+    UNUSED_PARAMETER(output);
+    return (void *) obs_data_get_int(settings, "owner");
+}
+
+void PacketOutput::output_destroy(void *data) {
+    UNUSED_PARAMETER(data);
+}
+
+bool PacketOutput::output_start(void *data) {
+    auto packetOutput = (PacketOutput *) data;
+    if (!obs_output_can_begin_data_capture(packetOutput->output, 0)) {
+        return false;
+    }
+    if (!obs_output_initialize_encoders(packetOutput->output, 0)) {
+        return false;
+    }
+    return obs_output_begin_data_capture(packetOutput->output, 0);
+}
+
+void PacketOutput::output_stop(void *data, uint64_t ts) {
+    UNUSED_PARAMETER(ts);
+    auto packetOutput = (PacketOutput *) data;
+    obs_output_end_data_capture(packetOutput->output);
+}
+
+void PacketOutput::output_encoded_packet(void *data, struct encoder_packet *packet) {
+    if (packet) {
+        ((PacketOutput *) data)->onPacket(packet);
+    }
+}
+
+void PacketOutput::onPacket(struct encoder_packet *packet) {
+    if (packet->type == OBS_ENCODER_VIDEO) {
+        videoPackets++;
+        // sys_dts_usec is in the os_gettime_ns clock of the raw frame, smooth it over a few frames.
+        int64_t latency = (int64_t) (os_gettime_ns() / 1000) - packet->sys_dts_usec;
+        int64_t previous = encoderLatencyUs;
+        encoderLatencyUs = previous == 0 ? latency : (previous * 7 + latency) / 8;
+    }
+
+    std::unique_lock<std::mutex> lock(replay_mtx);
+    if (replayMaxSec > 0) {
+        // Same limits as the replay buffer, oldest packets go first.
+        replayPackets.push_back({packet->dts_usec, packet->size});
+        replayBytes += (int64_t) packet->size;
+        while (replayPackets.size() > 1 &&
+               (replayPackets.back().dtsUsec - replayPackets.front().dtsUsec > (int64_t) replayMaxSec * 1000000 ||
+                replayBytes > replayMaxBytes)) {
+            replayBytes -= (int64_t) replayPackets.front().size;
+            replayPackets.pop_front();
+        }
+    }
+}
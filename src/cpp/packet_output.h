@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <obs.h>
+
+// An encoded output that receives the packets of existing encoders without
+// sending them anywhere. It measures the encoder latency of an Output and
+// the memory held by its replay buffer.
+class PacketOutput {
+
+public:
+    static void registerOutput();
+
+    PacketOutput(const std::string &name, obs_encoder_t *video_encoder,
+                 const std::vector<obs_encoder_t *> &audio_encoders);
+    ~PacketOutput();
+
+    void start();
+
+    void stop();
+
+    double getEncoderLatencyMs();
+
+    int getVideoPackets();
+
+    // Follows the packets kept by a replay buffer of maxSec and maxBytes.
+    void setReplayWindow(int maxSec, int64_t maxBytes);
+
+    int64_t getReplayBytes();
+
+    double getReplaySec();
+
+private:
+    static const char *output_get_name(void *type_data);
+    static void *output_create(obs_data_t *settings, obs_output_t *output);
+    static void output_destroy(void *data);
+    static bool output_start(void *data);
+    static void output_stop(void *data, uint64_t ts);
+    static void output_encoded_packet(void *data, struct encoder_packet *packet);
+
+    void onPacket(struct encoder_packet *packet);
+
+    std::string name;
+    obs_output_t *output;
+    std::atomic<int64_t> encoderLatencyUs;
+    std::atomic<int> videoPackets;
+
+    struct PacketInfo {
+        int64_t dtsUsec;
+        size_t size;
+    };
+    std::deque<PacketInfo> replayPackets;
+    int64_t replayBytes;
+    int replayMaxSec;
+    int64_t replayMaxBytes;
+    std::mutex replay_mtx;
+};
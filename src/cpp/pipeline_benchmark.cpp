@@ -0,0 +1,163 @@
+#include "pipeline_benchmark.h"
+#include "source_transcoder.h"
+#include "metrics.h"
+#include "studio.h"
+#include <obs.h>
+#include <algorithm>
+#include <chrono>
+#include <util/platform.h>
+
+#define BASELINE_DURATION 2000 // milliseconds
+
+#ifdef _WIN32
+#define NULL_SINK "NUL"
+#else
+#define NULL_SINK "/dev/null"
+#endif
+
+static double percentileMs(std::vector<uint64_t> &samples, double percentile) {
+    if (samples.empty()) {
+        return 0;
+    }
+    auto index = (size_t) (percentile * (double) (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return (double) samples[index] / 1000000.0;
+}
+
+Napi::Object PipelineBenchmarkResult::toNapiObject(Napi::Env env) const {
+    auto result = Napi::Object::New(env);
+    auto sourceResults = Napi::Array::New(env, sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        auto source = Napi::Object::New(env);
+        source.Set("sourceId", sources[i].sourceId);
+        source.Set("fps", sources[i].fps);
+        source.Set("skippedFrames", sources[i].skippedFrames);
+        source.Set("latencyP50Ms", sources[i].latencyP50Ms);
+        source.Set("latencyP99Ms", sources[i].latencyP99Ms);
+        source.Set("latencySamples", sources[i].latencySamples);
+        sourceResults.Set(i, source);
+    }
+    result.Set("sources", sourceResults);
+    result.Set("targetFps", targetFps);
+    result.Set("cpuPercent", cpuPercent);
+    result.Set("cpuPercentPerSource", cpuPercentPerSource);
+    result.Set("residentMb", residentMb);
+    return result;
+}
+
+PipelineBenchmarkResult PipelineBenchmark::run(const PipelineBenchmarkSettings &settings) {
+    PipelineBenchmarkResult result;
+
+    obs_video_info ovi = {};
+    obs_get_video_info(&ovi);
+    result.targetFps = (double) ovi.fps_num / ovi.fps_den;
+
+    // CPU of the process without the sources, what is left is the pipelines' share.
+    os_cpu_usage_info_t *cpu_info = os_cpu_usage_info_start();
+    bool aborted = !Studio::benchmarkSleep(std::chrono::milliseconds(BASELINE_DURATION));
+    double baselineCpu = os_cpu_usage_info_query(cpu_info);
+    os_cpu_usage_info_destroy(cpu_info);
+    if (aborted) {
+        throw std::runtime_error("Benchmark aborted by shutdown.");
+    }
+
+    std::vector<obs_source_t *> sources;
+    std::vector<SourceTranscoder *> transcoders;
+    auto cleanup = [&]() {
+        for (auto transcoder : transcoders) {
+            transcoder->stop();
+            delete transcoder;
+        }
+        for (auto source : sources) {
+            obs_source_release(source);
+        }
+    };
+
+    try {
+        for (int i = 0; i < settings.sources; ++i) {
+            std::string sourceId = "benchmark_" + std::to_string(i);
+            obs_data_t *source_settings = obs_data_create();
+            if (settings.input.empty()) {
+                std::string graph = "testsrc2=size=" + std::to_string(settings.inputWidth) + "x" +
+                                    std::to_string(settings.inputHeight) + ":rate=" +
+                                    std::to_string(settings.inputFps) + "[out0];sine=frequency=1000[out1]";
+                obs_data_set_bool(source_settings, "is_local_file", false);
+                obs_data_set_string(source_settings, "input", graph.c_str());
+                obs_data_set_string(source_settings, "input_format", "lavfi");
+            } else {
+                obs_data_set_bool(source_settings, "is_local_file", true);
+                obs_data_set_string(source_settings, "local_file", settings.input.c_str());
+                obs_data_set_bool(source_settings, "looping", true);
+            }
+            obs_data_set_bool(source_settings, "hw_decode", false);
+            obs_data_set_bool(source_settings, "close_when_inactive", false);
+            obs_data_set_bool(source_settings, "restart_on_activate", false);
+            obs_data_set_bool(source_settings, "clear_on_media_end", false);
+            obs_source_t *source = obs_source_create_private("ffmpeg_source", sourceId.c_str(), source_settings);
+            obs_data_release(source_settings);
+            if (!source) {
+                throw std::runtime_error("Failed to create benchmark source.");
+            }
+            sources.push_back(source);
+
+            auto outputSettings = std::make_shared<OutputSettings>(*settings.output);
+            outputSettings->url = settings.sink == "file" ? settings.outputDir + "/" + sourceId + ".ts" : NULL_SINK;
+            auto transcoder = new SourceTranscoder();
+            try {
+                transcoder->start(sourceId, source, outputSettings,
+                                  Output::metricsLabels("benchmark", "", sourceId, ""));
+            } catch (...) {
+                delete transcoder;
+                throw;
+            }
+            transcoders.push_back(transcoder);
+        }
+
+        if (!Studio::benchmarkSleep(std::chrono::seconds(settings.warmupSec))) {
+            throw std::runtime_error("Benchmark aborted by shutdown.");
+        }
+
+        std::vector<uint64_t> framesStart;
+        std::vector<uint32_t> skippedStart;
+        for (auto transcoder : transcoders) {
+            framesStart.push_back(transcoder->getOutputFrames());
+            skippedStart.push_back(transcoder->getSkippedFrames());
+            transcoder->setLatencySampling(true);
+        }
+        uint64_t timeStart = os_gettime_ns();
+        cpu_info = os_cpu_usage_info_start();
+
+        aborted = !Studio::benchmarkSleep(std::chrono::seconds(settings.durationSec));
+
+        double cpu = os_cpu_usage_info_query(cpu_info);
+        os_cpu_usage_info_destroy(cpu_info);
+        if (aborted) {
+            throw std::runtime_error("Benchmark aborted by shutdown.");
+        }
+        uint64_t elapsedNs = os_gettime_ns() - timeStart;
+        for (size_t i = 0; i < transcoders.size(); ++i) {
+            auto transcoder = transcoders[i];
+            transcoder->setLatencySampling(false);
+            auto samples = transcoder->takeLatencySamples();
+
+            PipelineBenchmarkResult::SourceResult sourceResult;
+            sourceResult.sourceId = "benchmark_" + std::to_string(i);
+            sourceResult.fps = (double) (transcoder->getOutputFrames() - framesStart[i]) * 1000000000.0 /
+                               (double) elapsedNs;
+            sourceResult.skippedFrames = (int) (transcoder->getSkippedFrames() - skippedStart[i]);
+            sourceResult.latencySamples = (int) samples.size();
+            sourceResult.latencyP50Ms = percentileMs(samples, 0.5);
+            sourceResult.latencyP99Ms = percentileMs(samples, 0.99);
+            result.sources.push_back(sourceResult);
+        }
+        result.cpuPercent = std::max(0.0, cpu - baselineCpu);
+        result.cpuPercentPerSource = result.cpuPercent / settings.sources;
+        result.residentMb = (double) Metrics::getResidentBytes() / (1024 * 1024);
+    } catch (...) {
+        cleanup();
+        throw;
+    }
+
+    cleanup();
+    return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "settings.h"
+
+struct PipelineBenchmarkResult {
+    struct SourceResult {
+        std::string sourceId;
+        double fps = 0;
+        int skippedFrames = 0;
+        double latencyP50Ms = 0;
+        double latencyP99Ms = 0;
+        int latencySamples = 0;
+    };
+    std::vector<SourceResult> sources;
+    double targetFps = 0;
+    double cpuPercent = 0; // Of the whole machine, above the idle baseline
+    double cpuPercentPerSource = 0;
+    double residentMb = 0; // Only known on Linux
+
+    Napi::Object toNapiObject(Napi::Env env) const;
+};
+
+// Runs sources through SourceTranscoder and Output as the studio does, with
+// a synthetic test pattern or a looped file as input and /dev/null or files
+// as sinks, and measures the throughput and frame latency of each source.
+// Latency is from a frame arriving from the decoder to its readback into
+// the encoder input. Inputs are deterministic, so runs of two commits on the
+// same machine compare.
+class PipelineBenchmark {
+
+public:
+    static PipelineBenchmarkResult run(const PipelineBenchmarkSettings &settings);
+};
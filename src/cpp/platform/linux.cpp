@@ -0,0 +1,14 @@
+#include "platform.h"
+
+// There are no native display windows on Linux, previews are rendered by
+// offscreen displays instead.
+
+void *createDisplayWindow(void *parentHandle) {
+    return nullptr;
+}
+
+void destroyWindow(void *windowHandle) {
+}
+
+void moveWindow(void *windowHandle, int x, int y, int width, int height) {
+}
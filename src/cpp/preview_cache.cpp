@@ -0,0 +1,96 @@
+#include "preview_cache.h"
+#include <algorithm>
+
+#define PREVIEW_CACHE_EXPIRE 1000000000 // nanoseconds
+
+PreviewCache::PreviewCache() :
+        entries(),
+        lastSweepTime(0) {
+}
+
+PreviewCache::~PreviewCache() {
+    obs_enter_graphics();
+    for (auto &entry : entries) {
+        gs_texrender_destroy(entry.second.texrender);
+    }
+    obs_leave_graphics();
+    entries.clear();
+}
+
+gs_texture_t *PreviewCache::getTexture(obs_source_t *source, uint32_t width, uint32_t height) {
+    uint32_t source_width = obs_source_get_width(source);
+    uint32_t source_height = obs_source_get_height(source);
+    if (source_width == 0 || source_height == 0 || width == 0 || height == 0) {
+        return nullptr;
+    }
+    // Never render a preview larger than the source itself.
+    if (width > source_width || height > source_height) {
+        width = source_width;
+        height = source_height;
+    }
+
+    uint64_t frameTime = obs_get_video_frame_time();
+    sweep(frameTime);
+
+    auto it = entries.find(source);
+    if (it == entries.end()) {
+        it = entries.insert({source, Entry{
+                .texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE),
+                .frameTime = 0,
+                .requestWidth = 0,
+                .requestHeight = 0,
+        }}).first;
+    }
+    Entry &entry = it->second;
+
+    if (entry.frameTime == frameTime) {
+        // Already rendered in this frame, remember the size for the next one.
+        entry.requestWidth = std::max(entry.requestWidth, width);
+        entry.requestHeight = std::max(entry.requestHeight, height);
+        return gs_texrender_get_texture(entry.texrender);
+    }
+
+    uint32_t cx = std::max(entry.requestWidth, width);
+    uint32_t cy = std::max(entry.requestHeight, height);
+    entry.frameTime = frameTime;
+    entry.requestWidth = width;
+    entry.requestHeight = height;
+
+    gs_texrender_reset(entry.texrender);
+    if (gs_texrender_begin(entry.texrender, cx, cy)) {
+        vec4 background = {};
+        vec4_zero(&background);
+        gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+        gs_ortho(0.0f, (float) source_width, 0.0f, (float) source_height, -100.0f, 100.0f);
+        gs_blend_state_push();
+        gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+        obs_source_video_render(source);
+        gs_blend_state_pop();
+        gs_texrender_end(entry.texrender);
+    }
+    return gs_texrender_get_texture(entry.texrender);
+}
+
+void PreviewCache::draw(gs_texture_t *texture, uint32_t width, uint32_t height) {
+    gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+    gs_eparam_t *param = gs_effect_get_param_by_name(effect, "image");
+    gs_effect_set_texture(param, texture);
+    while (gs_effect_loop(effect, "Draw")) {
+        gs_draw_sprite(texture, 0, width, height);
+    }
+}
+
+void PreviewCache::sweep(uint64_t frameTime) {
+    if (frameTime - lastSweepTime < PREVIEW_CACHE_EXPIRE) {
+        return;
+    }
+    lastSweepTime = frameTime;
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (frameTime - it->second.frameTime > PREVIEW_CACHE_EXPIRE) {
+            gs_texrender_destroy(it->second.texrender);
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
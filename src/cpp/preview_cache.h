@@ -0,0 +1,35 @@
+#pragma once
+
+#include <map>
+#include <obs.h>
+#include <graphics/graphics.h>
+
+// Low resolution copies of sources for previews. Each source is rendered at
+// most once per output frame, at the largest size asked by any display in
+// the previous frame, and the texture is reused by every display showing it.
+// All methods except the destructor must be called in the graphics thread,
+// displays use it from their draw callbacks and offscreen displays from a
+// main render callback, so it needs no lock.
+class PreviewCache {
+
+public:
+    PreviewCache();
+    ~PreviewCache();
+
+    gs_texture_t *getTexture(obs_source_t *source, uint32_t width, uint32_t height);
+
+    static void draw(gs_texture_t *texture, uint32_t width, uint32_t height);
+
+private:
+    struct Entry {
+        gs_texrender_t *texrender;
+        uint64_t frameTime;
+        uint32_t requestWidth;
+        uint32_t requestHeight;
+    };
+
+    void sweep(uint64_t frameTime);
+
+    std::map<obs_source_t *, Entry> entries;
+    uint64_t lastSweepTime;
+};
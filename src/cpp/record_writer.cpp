@@ -0,0 +1,330 @@
+#include "record_writer.h"
+#include "affinity.h"
+#include <cstring>
+#include <obs-avc.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define RECORD_WRITER_ID "obs_node_record_writer"
+#define FLV_TAG_AUDIO 8
+#define FLV_TAG_VIDEO 9
+#define FLV_TAG_HEADER_SIZE 11
+
+static void write_u24(std::vector<uint8_t> &data, uint32_t value) {
+    data.push_back((uint8_t) (value >> 16));
+    data.push_back((uint8_t) (value >> 8));
+    data.push_back((uint8_t) value);
+}
+
+static void write_u32(std::vector<uint8_t> &data, uint32_t value) {
+    data.push_back((uint8_t) (value >> 24));
+    write_u24(data, value);
+}
+
+void RecordWriter::registerOutput() {
+    obs_output_info info = {};
+    info.id = RECORD_WRITER_ID;
+    info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+    info.get_name = output_get_name;
+    info.create = output_create;
+    info.destroy = output_destroy;
+    info.start = output_start;
+    info.stop = output_stop;
+    info.encoded_packet = output_encoded_packet;
+    obs_register_output(&info);
+}
+
+FsyncPolicy RecordWriter::getFsyncPolicy(const std::string &fsyncPolicy) {
+    if (fsyncPolicy == "none") {
+        return FSYNC_NONE;
+    } else if (fsyncPolicy == "interval") {
+        return FSYNC_INTERVAL;
+    } else if (fsyncPolicy == "close") {
+        return FSYNC_CLOSE;
+    } else {
+        throw std::invalid_argument("Invalid fsync policy: " + fsyncPolicy);
+    }
+}
+
+RecordWriter::RecordWriter(const std::string &name, const std::string &path, obs_encoder_t *video_encoder,
+                           obs_encoder_t *audio_encoder, size_t bufferBytes, FsyncPolicy fsyncPolicy,
+                           int fsyncIntervalMs) :
+        name(name),
+        path(path),
+        video_encoder(video_encoder),
+        audio_encoder(audio_encoder),
+        bufferBytes(bufferBytes),
+        fsyncPolicy(fsyncPolicy),
+        fsyncIntervalMs(fsyncIntervalMs),
+        output(nullptr),
+        file(nullptr),
+        headersWritten(false),
+        waitKeyframe(true),
+        startDtsUsec(0),
+        queue(),
+        queueBytes(0),
+        writerStop(false),
+        queue_mtx(),
+        queue_cv(),
+        writer_thread(),
+        bytesWritten(0),
+        droppedPackets(0),
+        writeFailed(false) {
+    if (strcmp(obs_encoder_get_codec(video_encoder), "h264") != 0 ||
+        astrcmpi(obs_encoder_get_codec(audio_encoder), "aac") != 0) {
+        throw std::invalid_argument("Native record writer only supports H.264 and AAC");
+    }
+    // The output finds this object through its settings.
+    obs_data_t *settings = obs_data_create();
+    obs_data_set_int(settings, "owner", (long long) this);
+    output = obs_output_create(RECORD_WRITER_ID, (name + "_record").c_str(), settings, nullptr);
+    obs_data_release(settings);
+    if (!output) {
+        throw std::runtime_error("Failed to create record writer.");
+    }
+    obs_output_set_video_encoder(output, video_encoder);
+    obs_output_set_audio_encoder(output, audio_encoder, 0);
+}
+
+RecordWriter::~RecordWriter() {
+    stop();
+    obs_output_release(output);
+}
+
+void RecordWriter::start() {
+    file = os_fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to open record file: " + path);
+    }
+
+    // FLV header with audio and video, followed by the first previous tag size.
+    std::vector<uint8_t> header = {'F', 'L', 'V', 1, 0x05};
+    write_u32(header, 9);
+    write_u32(header, 0);
+    queue.push_back(std::move(header));
+    queueBytes = queue.back().size();
+
+    writerStop = false;
+    writer_thread = std::thread(&RecordWriter::writerLoop, this);
+    if (!obs_output_start(output)) {
+        stop();
+        throw std::runtime_error("Failed to start record writer.");
+    }
+}
+
+void RecordWriter::stop() {
+    if (obs_output_active(output)) {
+        obs_output_stop(output);
+    }
+    if (writer_thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mtx);
+            writerStop = true;
+        }
+        queue_cv.notify_one();
+        writer_thread.join();
+    }
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool RecordWriter::isActive() {
+    return obs_output_active(output) && !writeFailed;
+}
+
+uint64_t RecordWriter::getBytesWritten() {
+    return bytesWritten;
+}
+
+size_t RecordWriter::getBufferedBytes() {
+    std::unique_lock<std::mutex> lock(queue_mtx);
+    return queueBytes;
+}
+
+int RecordWriter::getDroppedPackets() {
+    return droppedPackets;
+}
+
+const char *RecordWriter::output_get_name(void *type_data) {
+    UNUSED_PARAMETER(type_data);
+    return "obs-node record writer";
+}
+
+void *RecordWriter::output_create(obs_data_t *settings, obs_output_t *output) {
+    UNUSED_PARAMETER(output);
+    return (void *) obs_data_get_int(settings, "owner");
+}
+
+void RecordWriter::output_destroy(void *data) {
+    UNUSED_PARAMETER(data);
+}
+
+bool RecordWriter::output_start(void *data) {
+    auto recordWriter = (RecordWriter *) data;
+    if (!obs_output_can_begin_data_capture(recordWriter->output, 0)) {
+        return false;
+    }
+    if (!obs_output_initialize_encoders(recordWriter->output, 0)) {
+        return false;
+    }
+    return obs_output_begin_data_capture(recordWriter->output, 0);
+}
+
+void RecordWriter::output_stop(void *data, uint64_t ts) {
+    UNUSED_PARAMETER(ts);
+    auto recordWriter = (RecordWriter *) data;
+    obs_output_end_data_capture(recordWriter->output);
+}
+
+void RecordWriter::output_encoded_packet(void *data, struct encoder_packet *packet) {
+    if (packet) {
+        ((RecordWriter *) data)->onPacket(packet);
+    }
+}
+
+void RecordWriter::onPacket(struct encoder_packet *packet) {
+    bool video = packet->type == OBS_ENCODER_VIDEO;
+    if (waitKeyframe) {
+        if (!video || !packet->keyframe) {
+            droppedPackets++;
+            return;
+        }
+        waitKeyframe = false;
+        if (!headersWritten) {
+            startDtsUsec = packet->dts_usec;
+        }
+    }
+    if (packet->dts_usec < startDtsUsec) {
+        return;
+    }
+    auto timestampMs = (packet->dts_usec - startDtsUsec) / 1000;
+    if (!headersWritten) {
+        writeHeaders(timestampMs);
+        headersWritten = true;
+    }
+
+    std::vector<uint8_t> data;
+    if (video) {
+        // FLV wants length prefixed NAL units.
+        encoder_packet parsed = {};
+        obs_parse_avc_packet(&parsed, packet);
+        auto compositionMs = (int32_t) ((parsed.pts - parsed.dts) * 1000 * parsed.timebase_num / parsed.timebase_den);
+        data.reserve(parsed.size + 5);
+        data.push_back(parsed.keyframe ? 0x17 : 0x27);
+        data.push_back(1);
+        write_u24(data, (uint32_t) compositionMs);
+        data.insert(data.end(), parsed.data, parsed.data + parsed.size);
+        obs_encoder_packet_release(&parsed);
+    } else {
+        data.reserve(packet->size + 2);
+        data.push_back(0xAF);
+        data.push_back(1);
+        data.insert(data.end(), packet->data, packet->data + packet->size);
+    }
+    pushTag(video ? FLV_TAG_VIDEO : FLV_TAG_AUDIO, timestampMs, data, false);
+}
+
+void RecordWriter::writeHeaders(int64_t timestampMs) {
+    uint8_t *extra = nullptr;
+    size_t extraSize = 0;
+
+    std::vector<uint8_t> videoHeader = {0x17, 0, 0, 0, 0};
+    if (obs_encoder_get_extra_data(video_encoder, &extra, &extraSize)) {
+        uint8_t *header = nullptr;
+        size_t headerSize = obs_parse_avc_header(&header, extra, extraSize);
+        videoHeader.insert(videoHeader.end(), header, header + headerSize);
+        bfree(header);
+    }
+    pushTag(FLV_TAG_VIDEO, timestampMs, videoHeader, true);
+
+    std::vector<uint8_t> audioHeader = {0xAF, 0};
+    if (obs_encoder_get_extra_data(audio_encoder, &extra, &extraSize)) {
+        audioHeader.insert(audioHeader.end(), extra, extra + extraSize);
+    }
+    pushTag(FLV_TAG_AUDIO, timestampMs, audioHeader, true);
+}
+
+void RecordWriter::pushTag(uint8_t type, int64_t timestampMs, const std::vector<uint8_t> &data, bool force) {
+    std::vector<uint8_t> tag;
+    tag.reserve(FLV_TAG_HEADER_SIZE + data.size() + 4);
+    tag.push_back(type);
+    write_u24(tag, (uint32_t) data.size());
+    write_u24(tag, (uint32_t) timestampMs);
+    tag.push_back((uint8_t) (timestampMs >> 24));
+    write_u24(tag, 0);
+    tag.insert(tag.end(), data.begin(), data.end());
+    write_u32(tag, (uint32_t) (FLV_TAG_HEADER_SIZE + data.size()));
+
+    {
+        std::unique_lock<std::mutex> lock(queue_mtx);
+        if (!force && queueBytes + tag.size() > bufferBytes) {
+            // The disk is behind, never block the encoders, resume at the next keyframe.
+            droppedPackets++;
+            waitKeyframe = true;
+            return;
+        }
+        queueBytes += tag.size();
+        queue.push_back(std::move(tag));
+    }
+    queue_cv.notify_one();
+}
+
+void RecordWriter::writerLoop() {
+    ThreadPlacement placement(THREAD_OUTPUT, "record writer " + name);
+    uint64_t lastSync = os_gettime_ns();
+    while (true) {
+        std::vector<uint8_t> data;
+        {
+            std::unique_lock<std::mutex> lock(queue_mtx);
+            queue_cv.wait_for(lock, std::chrono::milliseconds(fsyncIntervalMs), [this] {
+                return writerStop || !queue.empty();
+            });
+            if (queue.empty()) {
+                if (writerStop) {
+                    break;
+                }
+            } else {
+                data = std::move(queue.front());
+                queue.pop_front();
+                queueBytes -= data.size();
+            }
+        }
+
+        if (!data.empty() && !writeFailed) {
+            if (fwrite(data.data(), 1, data.size(), file) != data.size()) {
+                blog(LOG_ERROR, "Failed to write record file: %s", path.c_str());
+                writeFailed = true;
+            } else {
+                bytesWritten += data.size();
+            }
+        }
+
+        uint64_t now = os_gettime_ns();
+        if (fsyncPolicy == FSYNC_INTERVAL && now - lastSync >= (uint64_t) fsyncIntervalMs * 1000000) {
+            syncFile();
+            lastSync = now;
+        }
+    }
+    if (fsyncPolicy != FSYNC_NONE) {
+        syncFile();
+    } else {
+        fflush(file);
+    }
+}
+
+void RecordWriter::syncFile() {
+    fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <obs.h>
+
+enum FsyncPolicy {
+    FSYNC_NONE,
+    FSYNC_INTERVAL,
+    FSYNC_CLOSE,
+};
+
+// An encoded output that records H.264/AAC packets of existing encoders to a
+// FLV file in process. Packets are muxed into a write-ahead queue on the
+// encoder thread and written by a thread of its own, a full queue drops
+// packets until the next keyframe instead of blocking the encoders.
+class RecordWriter {
+
+public:
+    static void registerOutput();
+
+    static FsyncPolicy getFsyncPolicy(const std::string &fsyncPolicy);
+
+    RecordWriter(const std::string &name, const std::string &path, obs_encoder_t *video_encoder,
+                 obs_encoder_t *audio_encoder, size_t bufferBytes, FsyncPolicy fsyncPolicy, int fsyncIntervalMs);
+    ~RecordWriter();
+
+    void start();
+
+    void stop();
+
+    bool isActive();
+
+    uint64_t getBytesWritten();
+
+    size_t getBufferedBytes();
+
+    int getDroppedPackets();
+
+private:
+    static const char *output_get_name(void *type_data);
+    static void *output_create(obs_data_t *settings, obs_output_t *output);
+    static void output_destroy(void *data);
+    static bool output_start(void *data);
+    static void output_stop(void *data, uint64_t ts);
+    static void output_encoded_packet(void *data, struct encoder_packet *packet);
+
+    void onPacket(struct encoder_packet *packet);
+    void writeHeaders(int64_t timestampMs);
+    void pushTag(uint8_t type, int64_t timestampMs, const std::vector<uint8_t> &data, bool force);
+    void writerLoop();
+    void syncFile();
+
+    std::string name;
+    std::string path;
+    obs_encoder_t *video_encoder;
+    obs_encoder_t *audio_encoder;
+    size_t bufferBytes;
+    FsyncPolicy fsyncPolicy;
+    int fsyncIntervalMs;
+    obs_output_t *output;
+    FILE *file;
+
+    // Muxing, on the encoder thread
+    bool headersWritten;
+    bool waitKeyframe;
+    int64_t startDtsUsec;
+
+    // Write-ahead queue
+    std::deque<std::vector<uint8_t>> queue;
+    size_t queueBytes;
+    bool writerStop;
+    std::mutex queue_mtx;
+    std::condition_variable queue_cv;
+    std::thread writer_thread;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<int> droppedPackets;
+    std::atomic<bool> writeFailed;
+};
@@ -1,24 +1,31 @@
 #include "scene.h"
 #include <map>
 
-Scene::Scene(std::string &id, int index, Settings *settings) :
+Scene::Scene(std::string &id, int index, SourcePool *pool, Settings *settings) :
         id(id),
         index(index),
+        pool(pool),
         settings(settings),
-        obs_scene(createObsScene(id)) {
+        obs_scene(createObsScene(id)),
+        handle(std::make_shared<SourceHandle>(obs_scene_get_source(obs_scene))),
+        onProgram(false),
+        prepared(false) {
 }
 
 Scene::~Scene() {
+    unprepare(false);
     for (auto source : sources) {
         delete source.second;
     }
+    handle->reset(nullptr);
     if (obs_scene) {
         obs_scene_release(obs_scene);
     }
 }
 
 void Scene::addSource(std::string &sourceId, Settings *studioSettings, const Napi::Object &settings) {
-    auto source = new Source(sourceId, id, obs_scene, studioSettings, settings);
+    auto source = new Source(sourceId, id, obs_scene, pool, studioSettings, settings);
+    source->setOnProgram(onProgram);
     sources[sourceId] = source;
 }
 
@@ -42,6 +49,52 @@ obs_scene_t *Scene::getScene() {
     return obs_scene;
 }
 
+std::shared_ptr<SourceHandle> Scene::getHandle() {
+    return handle;
+}
+
 std::map<std::string, Source *> &Scene::getSources() {
     return sources;
 }
+
+void Scene::setOnProgram(bool onProgram) {
+    this->onProgram = onProgram;
+    for (auto &source : sources) {
+        source.second->setOnProgram(onProgram);
+    }
+}
+
+void Scene::prepare() {
+    if (!prepared) {
+        // Showing the scene keeps it rendered before it's on program.
+        obs_source_inc_showing(obs_scene_get_source(obs_scene));
+        prepared = true;
+    }
+    for (auto &source : sources) {
+        source.second->prepare();
+    }
+}
+
+void Scene::unprepare(bool rewind) {
+    if (!prepared) {
+        return;
+    }
+    for (auto &source : sources) {
+        source.second->unprepare(rewind);
+    }
+    obs_source_dec_showing(obs_scene_get_source(obs_scene));
+    prepared = false;
+}
+
+bool Scene::isPrepared() {
+    return prepared;
+}
+
+bool Scene::isReady() {
+    for (auto &source : sources) {
+        if (!source.second->isReady()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -2,13 +2,14 @@
 
 #include "settings.h"
 #include "source.h"
+#include "source_pool.h"
 #include <string>
 #include <map>
 #include <obs.h>
 
 class Scene {
 public:
-    Scene(std::string &id, int index, Settings *settings);
+    Scene(std::string &id, int index, SourcePool *pool, Settings *settings);
     ~Scene();
 
     std::string getId() { return id; }
@@ -21,12 +22,28 @@ public:
 
     std::map<std::string, Source *> &getSources();
 
+    void setOnProgram(bool onProgram);
+
+    void prepare();
+
+    void unprepare(bool rewind);
+
+    bool isPrepared();
+
+    bool isReady();
+
+    std::shared_ptr<SourceHandle> getHandle();
+
 private:
     static obs_scene_t *createObsScene(std::string &sceneId);
 
     std::string id;
     int index;
+    SourcePool *pool;
     Settings *settings;
     obs_scene_t *obs_scene;
+    std::shared_ptr<SourceHandle> handle;
     std::map<std::string, Source *> sources;
+    bool onProgram;
+    bool prepared;
 };
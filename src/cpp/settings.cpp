@@ -1,5 +1,6 @@
 #include "settings.h"
 #include "utils.h"
+#include <cctype>
 
 VideoSettings::VideoSettings(const Napi::Object &videoSettings) {
     baseWidth = NapiUtil::getInt(videoSettings, "baseWidth");
@@ -14,6 +15,277 @@ AudioSettings::AudioSettings(const Napi::Object &audioSettings) {
     sampleRate = NapiUtil::getInt(audioSettings, "sampleRate");
 }
 
+TransitionSettings::TransitionSettings(const Napi::Object &transitionSettings) {
+    type = NapiUtil::getString(transitionSettings, "type");
+    auto value = transitionSettings.Get("settings");
+    settingsJson = value.IsUndefined() || value.IsNull() ? "" : NapiUtil::stringify(transitionSettings.Env(), value);
+}
+
+DisplaySettings::DisplaySettings() :
+        multiview(false),
+        columns(0),
+        fps(0) {
+}
+
+DisplaySettings::DisplaySettings(const Napi::Object &displaySettings) {
+    multiview = NapiUtil::getStringOptional(displaySettings, "layout").value_or("default") == "multiview";
+    columns = NapiUtil::getIntOptional(displaySettings, "columns").value_or(0);
+    fps = NapiUtil::getIntOptional(displaySettings, "fps").value_or(0);
+}
+
+SrtSettings::SrtSettings() :
+        latencyMs(0) {
+}
+
+SrtSettings::SrtSettings(const Napi::Object &srtSettings) {
+    latencyMs = NapiUtil::getIntOptional(srtSettings, "latencyMs").value_or(0);
+    passphrase = NapiUtil::getStringOptional(srtSettings, "passphrase").value_or("");
+    mode = NapiUtil::getStringOptional(srtSettings, "mode").value_or("");
+    streamId = NapiUtil::getStringOptional(srtSettings, "streamId").value_or("");
+    if (!mode.empty() && mode != "caller" && mode != "listener" && mode != "rendezvous") {
+        throw std::invalid_argument("SRT mode should be caller, listener or rendezvous");
+    }
+    if (!passphrase.empty() && (passphrase.size() < 10 || passphrase.size() > 79)) {
+        throw std::invalid_argument("SRT passphrase should be 10 to 79 characters");
+    }
+}
+
+bool SrtSettings::equals(const SrtSettings &settings) const {
+    return latencyMs == settings.latencyMs &&
+           passphrase == settings.passphrase &&
+           mode == settings.mode &&
+           streamId == settings.streamId;
+}
+
+// FFmpeg url-decodes the libsrt options, streamids like "#!::r=live,m=publish" need encoding.
+static std::string percentEncode(const std::string &value) {
+    static const char *hex = "0123456789ABCDEF";
+    std::string result;
+    for (unsigned char c : value) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            result += (char) c;
+        } else {
+            result += '%';
+            result += hex[c >> 4];
+            result += hex[c & 0xF];
+        }
+    }
+    return result;
+}
+
+std::string SrtSettings::apply(const std::string &url) const {
+    if (url.rfind("srt://", 0) != 0) {
+        return url;
+    }
+    std::string result = url;
+    auto append = [&result](const std::string &name, const std::string &value) {
+        result += (result.find('?') == std::string::npos ? "?" : "&") + name + "=" + percentEncode(value);
+    };
+    if (latencyMs > 0) {
+        // libsrt latency option of FFmpeg is in microseconds
+        append("latency", std::to_string((int64_t) latencyMs * 1000));
+    }
+    if (!passphrase.empty()) {
+        append("passphrase", passphrase);
+    }
+    if (!mode.empty()) {
+        append("mode", mode);
+    }
+    if (!streamId.empty()) {
+        append("streamid", streamId);
+    }
+    return result;
+}
+
+SegmentSettings::SegmentSettings(const Napi::Object &segmentSettings) {
+    path = NapiUtil::getString(segmentSettings, "path");
+    segmentSec = NapiUtil::getIntOptional(segmentSettings, "segmentSec").value_or(2);
+    partMs = NapiUtil::getIntOptional(segmentSettings, "partMs").value_or(0);
+    windowSize = NapiUtil::getIntOptional(segmentSettings, "windowSize").value_or(10);
+    deleteSegments = NapiUtil::getBooleanOptional(segmentSettings, "deleteSegments").value_or(true);
+    bool hls = path.size() > 5 && path.compare(path.size() - 5, 5, ".m3u8") == 0;
+    bool dash = path.size() > 4 && path.compare(path.size() - 4, 4, ".mpd") == 0;
+    if (!hls && !dash) {
+        throw std::invalid_argument("Segment path should be a .m3u8 playlist or a .mpd manifest");
+    }
+    if (path.find(' ') != std::string::npos) {
+        throw std::invalid_argument("Segment path can't contain spaces");
+    }
+    if (hls && partMs > 0) {
+        throw std::invalid_argument("Partial segments need a .mpd manifest, FFmpeg HLS muxer can't write parts");
+    }
+    if (segmentSec <= 0 || windowSize <= 0 || partMs < 0) {
+        throw std::invalid_argument("Invalid segment settings");
+    }
+}
+
+bool SegmentSettings::equals(const std::shared_ptr<SegmentSettings> &settings) const {
+    return settings &&
+           path == settings->path &&
+           segmentSec == settings->segmentSec &&
+           partMs == settings->partMs &&
+           windowSize == settings->windowSize &&
+           deleteSegments == settings->deleteSegments;
+}
+
+std::string SegmentSettings::getMuxerSettings() const {
+    // Segments are written next to the playlist, named after it.
+    auto slash = path.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    std::string base = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    base = base.substr(0, base.rfind('.'));
+
+    if (path.compare(path.size() - 4, 4, ".mpd") == 0) {
+        // The DASH muxer only keeps segments on disk with an unlimited window.
+        std::string result = "seg_duration=" + std::to_string(segmentSec) +
+                             " window_size=" + std::to_string(deleteSegments ? windowSize : 0) +
+                             " extra_window_size=" + std::to_string(windowSize) +
+                             " use_template=1 use_timeline=0 dash_segment_type=mp4" +
+                             " init_seg_name=" + base + "_init_$RepresentationID$.m4s" +
+                             " media_seg_name=" + base + "_$RepresentationID$_$Number%05d$.m4s";
+        if (partMs > 0) {
+            // CMAF chunks of partMs, with an LL-HLS style playlist next to the manifest.
+            result += " streaming=1 ldash=1 lhls=1 frag_type=duration frag_duration=" +
+                      std::to_string(partMs / 1000.0);
+        }
+        return result;
+    }
+
+    std::string flags = "independent_segments+program_date_time";
+    if (deleteSegments) {
+        flags += "+delete_segments";
+    }
+    return "hls_time=" + std::to_string(segmentSec) +
+           " hls_list_size=" + std::to_string(windowSize) +
+           " hls_segment_type=fmp4 hls_flags=" + flags +
+           " hls_fmp4_init_filename=" + base + "_init.mp4" +
+           " hls_segment_filename=" + directory + base + "_%05d.m4s";
+}
+
+EncoderBenchmarkSettings::EncoderBenchmarkSettings(const Napi::Object &benchmarkSettings) {
+    auto encoders = benchmarkSettings.Get("encoders").As<Napi::Array>();
+    for (uint32_t i = 0; i < encoders.Length(); ++i) {
+        auto encoder = encoders.Get(i).As<Napi::Object>();
+        auto encoderSettings = encoder.Get("settings");
+        candidates.push_back({
+            NapiUtil::getString(encoder, "id"),
+            encoderSettings.IsUndefined() || encoderSettings.IsNull() ? "" : NapiUtil::stringify(benchmarkSettings.Env(), encoderSettings)
+        });
+    }
+    width = NapiUtil::getInt(benchmarkSettings, "width");
+    height = NapiUtil::getInt(benchmarkSettings, "height");
+    bitrateKbps = NapiUtil::getIntOptional(benchmarkSettings, "bitrateKbps").value_or(4000);
+    durationSec = NapiUtil::getIntOptional(benchmarkSettings, "durationSec").value_or(10);
+    if (candidates.empty() || width <= 0 || height <= 0 || bitrateKbps <= 0 || durationSec <= 0) {
+        throw std::invalid_argument("Invalid encoder benchmark settings");
+    }
+}
+
+PipelineBenchmarkSettings::PipelineBenchmarkSettings(const Napi::Object &benchmarkSettings) {
+    sources = NapiUtil::getIntOptional(benchmarkSettings, "sources").value_or(1);
+    input = NapiUtil::getStringOptional(benchmarkSettings, "input").value_or("");
+    inputWidth = NapiUtil::getIntOptional(benchmarkSettings, "inputWidth").value_or(1920);
+    inputHeight = NapiUtil::getIntOptional(benchmarkSettings, "inputHeight").value_or(1080);
+    inputFps = NapiUtil::getIntOptional(benchmarkSettings, "inputFps").value_or(25);
+    sink = NapiUtil::getStringOptional(benchmarkSettings, "sink").value_or("null");
+    outputDir = NapiUtil::getStringOptional(benchmarkSettings, "outputDir").value_or("");
+    warmupSec = NapiUtil::getIntOptional(benchmarkSettings, "warmupSec").value_or(5);
+    durationSec = NapiUtil::getIntOptional(benchmarkSettings, "durationSec").value_or(30);
+    if (sources <= 0 || inputWidth <= 0 || inputHeight <= 0 || inputFps <= 0 || warmupSec < 0 || durationSec <= 0) {
+        throw std::invalid_argument("Invalid pipeline benchmark settings");
+    }
+    if (sink != "null" && sink != "file") {
+        throw std::invalid_argument("Invalid pipeline benchmark sink: " + sink);
+    }
+    if (sink == "file" && outputDir.empty()) {
+        throw std::invalid_argument("outputDir is required by the file sink");
+    }
+
+    // The sink decides the url, copy the output settings to give them one.
+    auto outputSettings = benchmarkSettings.Get("output").As<Napi::Object>();
+    auto outputCopy = Napi::Object::New(benchmarkSettings.Env());
+    auto names = outputSettings.GetPropertyNames();
+    for (uint32_t i = 0; i < names.Length(); ++i) {
+        outputCopy.Set(names.Get(i), outputSettings.Get(names.Get(i)));
+    }
+    outputCopy.Set("url", "");
+    output = std::make_shared<OutputSettings>(outputCopy);
+}
+
+AffinitySettings::AffinitySettings(const Napi::Object &affinitySettings) {
+    render = NapiUtil::getStringOptional(affinitySettings, "render").value_or("");
+    audio = NapiUtil::getStringOptional(affinitySettings, "audio").value_or("");
+    encoder = NapiUtil::getStringOptional(affinitySettings, "encoder").value_or("");
+    transcoder = NapiUtil::getStringOptional(affinitySettings, "transcoder").value_or("");
+    output = NapiUtil::getStringOptional(affinitySettings, "output").value_or("");
+    control = NapiUtil::getStringOptional(affinitySettings, "control").value_or("");
+}
+
+OffscreenDisplaySettings::OffscreenDisplaySettings(const Napi::Object &offscreenDisplaySettings) {
+    width = NapiUtil::getInt(offscreenDisplaySettings, "width");
+    height = NapiUtil::getInt(offscreenDisplaySettings, "height");
+    fps = NapiUtil::getIntOptional(offscreenDisplaySettings, "fps").value_or(5);
+    columns = NapiUtil::getIntOptional(offscreenDisplaySettings, "columns").value_or(0);
+    if (width <= 0 || height <= 0 || fps <= 0) {
+        throw std::invalid_argument("Offscreen display width, height and fps should be positive");
+    }
+    auto outputSettings = offscreenDisplaySettings.Get("output");
+    if (!outputSettings.IsUndefined() && !outputSettings.IsNull()) {
+        output = std::make_shared<OutputSettings>(outputSettings.As<Napi::Object>());
+    }
+}
+
+FrameTapSettings::FrameTapSettings(const Napi::Object &frameTapSettings) {
+    name = NapiUtil::getString(frameTapSettings, "name");
+    offscreenDisplay = NapiUtil::getStringOptional(frameTapSettings, "offscreenDisplay").value_or("");
+    videoFormat = NapiUtil::getStringOptional(frameTapSettings, "videoFormat").value_or("NV12");
+    width = NapiUtil::getIntOptional(frameTapSettings, "width").value_or(0);
+    height = NapiUtil::getIntOptional(frameTapSettings, "height").value_or(0);
+    audio = NapiUtil::getBooleanOptional(frameTapSettings, "audio").value_or(offscreenDisplay.empty());
+    slots = NapiUtil::getIntOptional(frameTapSettings, "slots").value_or(8);
+    if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos) {
+        throw std::invalid_argument("Frame tap name should be like /name: " + name);
+    }
+    if (videoFormat != "NV12" && videoFormat != "BGRA") {
+        throw std::invalid_argument("Frame tap video format should be NV12 or BGRA");
+    }
+    if (slots < 2) {
+        throw std::invalid_argument("Frame tap should have at least 2 slots");
+    }
+}
+
+FrameSubscriptionSettings::FrameSubscriptionSettings(const Napi::Object &frameSubscriptionSettings) {
+    offscreenDisplay = NapiUtil::getStringOptional(frameSubscriptionSettings, "offscreenDisplay").value_or("");
+    format = NapiUtil::getStringOptional(frameSubscriptionSettings, "format").value_or("BGRA");
+    width = NapiUtil::getIntOptional(frameSubscriptionSettings, "width").value_or(0);
+    fps = NapiUtil::getIntOptional(frameSubscriptionSettings, "fps").value_or(0);
+    poolSize = NapiUtil::getIntOptional(frameSubscriptionSettings, "poolSize").value_or(3);
+    if (format != "BGRA" && format != "RGBA" && format != "NV12" && format != "I420") {
+        throw std::invalid_argument("Frame format should be BGRA, RGBA, NV12 or I420");
+    }
+    if (poolSize < 1) {
+        throw std::invalid_argument("Frame pool size should be positive");
+    }
+}
+
+DisplaySource::DisplaySource(const Napi::Value &displaySource) {
+    if (displaySource.IsString()) {
+        sourceId = displaySource.As<Napi::String>();
+        return;
+    }
+    auto object = displaySource.As<Napi::Object>();
+    sceneId = NapiUtil::getString(object, "sceneId");
+    sourceId = NapiUtil::getStringOptional(object, "sourceId").value_or("");
+}
+
+std::vector<DisplaySource> DisplaySource::fromArray(const Napi::Array &array) {
+    std::vector<DisplaySource> result;
+    for (uint32_t i = 0; i < array.Length(); ++i) {
+        result.emplace_back(array.Get(i));
+    }
+    return result;
+}
+
 OutputSettings::OutputSettings(const Napi::Object &outputSettings) {
     url = NapiUtil::getString(outputSettings, "url");
     hardwareEnable = NapiUtil::getBoolean(outputSettings, "hardwareEnable");
@@ -25,13 +297,63 @@ OutputSettings::OutputSettings(const Napi::Object &outputSettings) {
     profile = NapiUtil::getString(outputSettings, "profile");
     tune = NapiUtil::getString(outputSettings, "tune");
     x264opts = NapiUtil::getStringOptional(outputSettings, "x264opts").value_or("");
+    videoEncoder = NapiUtil::getStringOptional(outputSettings, "videoEncoder").value_or(hardwareEnable ? "ffmpeg_nvenc" : "obs_x264");
+    encoderCores = NapiUtil::getStringOptional(outputSettings, "encoderCores").value_or("");
+    threadCores = NapiUtil::getStringOptional(outputSettings, "threadCores").value_or("");
+    auto encoderSettings = outputSettings.Get("videoEncoderSettings");
+    videoEncoderSettingsJson = encoderSettings.IsUndefined() || encoderSettings.IsNull() ? "" : NapiUtil::stringify(outputSettings.Env(), encoderSettings);
     videoBitrateKbps = NapiUtil::getInt(outputSettings, "videoBitrateKbps");
     audioBitrateKbps = NapiUtil::getInt(outputSettings, "audioBitrateKbps");
     delaySec = NapiUtil::getIntOptional(outputSettings, "delaySec").value_or(0);
     mixers = NapiUtil::getIntOptional(outputSettings, "mixers").value_or(1);
     recordEnable = NapiUtil::getBooleanOptional(outputSettings, "recordEnable").value_or(false);
     recordFilePath = NapiUtil::getStringOptional(outputSettings, "recordFilePath").value_or("");
+    recordWriter = NapiUtil::getStringOptional(outputSettings, "recordWriter").value_or("ffmpeg");
+    recordBufferMb = NapiUtil::getIntOptional(outputSettings, "recordBufferMb").value_or(64);
+    recordFsync = NapiUtil::getStringOptional(outputSettings, "recordFsync").value_or("interval");
+    recordFsyncIntervalMs = NapiUtil::getIntOptional(outputSettings, "recordFsyncIntervalMs").value_or(1000);
+    if (recordWriter != "ffmpeg" && recordWriter != "native") {
+        throw std::invalid_argument("Invalid recordWriter: " + recordWriter);
+    }
+    if (recordFsync != "none" && recordFsync != "interval" && recordFsync != "close") {
+        throw std::invalid_argument("Invalid recordFsync: " + recordFsync);
+    }
+    // The native writer only muxes FLV, whatever the extension says.
+    if (recordEnable && recordWriter == "native" &&
+        (recordFilePath.size() < 4 || recordFilePath.compare(recordFilePath.size() - 4, 4, ".flv") != 0)) {
+        throw std::invalid_argument("recordFilePath should end with .flv for the native recordWriter: " + recordFilePath);
+    }
+    if (recordBufferMb <= 0 || recordFsyncIntervalMs <= 0) {
+        throw std::invalid_argument("Invalid record buffer settings");
+    }
     enableAbsoluteTimestamp = NapiUtil::getBooleanOptional(outputSettings, "enableAbsoluteTimestamp").value_or(false);
+    dynamicBitrate = NapiUtil::getBooleanOptional(outputSettings, "dynamicBitrate").value_or(false);
+    minVideoBitrateKbps = NapiUtil::getIntOptional(outputSettings, "minVideoBitrateKbps").value_or(videoBitrateKbps / 4);
+    maxVideoBitrateKbps = NapiUtil::getIntOptional(outputSettings, "maxVideoBitrateKbps").value_or(videoBitrateKbps);
+    autoReconnect = NapiUtil::getBooleanOptional(outputSettings, "autoReconnect").value_or(false);
+    reconnectDelayMs = NapiUtil::getIntOptional(outputSettings, "reconnectDelayMs").value_or(1000);
+    reconnectMaxDelayMs = NapiUtil::getIntOptional(outputSettings, "reconnectMaxDelayMs").value_or(30000);
+    reconnectMaxRetries = NapiUtil::getIntOptional(outputSettings, "reconnectMaxRetries").value_or(0);
+    if (!NapiUtil::isUndefined(outputSettings, "srt")) {
+        srt = SrtSettings(outputSettings.Get("srt").As<Napi::Object>());
+    }
+    auto segmentSettings = outputSettings.Get("segment");
+    if (!segmentSettings.IsUndefined() && !segmentSettings.IsNull()) {
+        segment = std::make_shared<SegmentSettings>(segmentSettings.As<Napi::Object>());
+    }
+    replaySec = NapiUtil::getIntOptional(outputSettings, "replaySec").value_or(0);
+    replayMaxMemoryMb = NapiUtil::getIntOptional(outputSettings, "replayMaxMemoryMb").value_or(512);
+    if (replaySec < 0 || replayMaxMemoryMb <= 0) {
+        throw std::invalid_argument("Invalid replay settings");
+    }
+    if (dynamicBitrate && (minVideoBitrateKbps <= 0 || minVideoBitrateKbps > videoBitrateKbps ||
+                           maxVideoBitrateKbps < videoBitrateKbps)) {
+        throw std::invalid_argument("Video bitrate should be between minVideoBitrateKbps and maxVideoBitrateKbps");
+    }
+    // Record, segments and replays share the video encoder, the live link's congestion would lower their quality.
+    if (dynamicBitrate && (recordEnable || segment || replaySec > 0)) {
+        throw std::invalid_argument("dynamicBitrate can't be combined with record, segment or replay");
+    }
 }
 
 bool OutputSettings::equals(const std::shared_ptr<OutputSettings> &settings) {
@@ -45,13 +367,32 @@ bool OutputSettings::equals(const std::shared_ptr<OutputSettings> &settings) {
             profile == settings->profile &&
             tune == settings->tune &&
             x264opts == settings->x264opts &&
+            videoEncoder == settings->videoEncoder &&
+            videoEncoderSettingsJson == settings->videoEncoderSettingsJson &&
+            encoderCores == settings->encoderCores &&
+            threadCores == settings->threadCores &&
             videoBitrateKbps == settings->videoBitrateKbps &&
             audioBitrateKbps == settings->audioBitrateKbps &&
             delaySec == settings->delaySec &&
             mixers == settings->mixers &&
             recordEnable == settings->recordEnable &&
             recordFilePath == settings->recordFilePath &&
-            enableAbsoluteTimestamp == settings->enableAbsoluteTimestamp;
+            recordWriter == settings->recordWriter &&
+            recordBufferMb == settings->recordBufferMb &&
+            recordFsync == settings->recordFsync &&
+            recordFsyncIntervalMs == settings->recordFsyncIntervalMs &&
+            enableAbsoluteTimestamp == settings->enableAbsoluteTimestamp &&
+            dynamicBitrate == settings->dynamicBitrate &&
+            minVideoBitrateKbps == settings->minVideoBitrateKbps &&
+            maxVideoBitrateKbps == settings->maxVideoBitrateKbps &&
+            autoReconnect == settings->autoReconnect &&
+            reconnectDelayMs == settings->reconnectDelayMs &&
+            reconnectMaxDelayMs == settings->reconnectMaxDelayMs &&
+            reconnectMaxRetries == settings->reconnectMaxRetries &&
+            srt.equals(settings->srt) &&
+            (segment ? segment->equals(settings->segment) : !settings->segment) &&
+            replaySec == settings->replaySec &&
+            replayMaxMemoryMb == settings->replayMaxMemoryMb;
 }
 
 Settings::Settings(const Napi::Object &settings) :
@@ -65,6 +406,25 @@ Settings::Settings(const Napi::Object &settings) :
     timestampFontHeight = NapiUtil::getIntOptional(settings, "timestampFontHeight").value_or(40);
     multiSourceSyncThreshold = NapiUtil::getIntOptional(settings, "multiSourceSyncThreshold").value_or(40);
     multiSourceSyncMaxDistance = NapiUtil::getIntOptional(settings, "multiSourceSyncMaxDistance").value_or(5000);
+    sourcePoolGraceSec = NapiUtil::getIntOptional(settings, "sourcePoolGraceSec").value_or(0);
+    shareSources = NapiUtil::getBooleanOptional(settings, "shareSources").value_or(false);
+    sceneReadyTimeoutMs = NapiUtil::getIntOptional(settings, "sceneReadyTimeoutMs").value_or(1000);
+    tBarSmoothingMs = NapiUtil::getIntOptional(settings, "tBarSmoothingMs").value_or(60);
+    encoderCpuCores = NapiUtil::getIntOptional(settings, "encoderCpuCores").value_or(0);
+    encoderCpuPixels = NapiUtil::getIntOptional(settings, "encoderCpuPixels").value_or(0);
+    metricsPort = NapiUtil::getIntOptional(settings, "metricsPort").value_or(0);
+    metricsHost = NapiUtil::getStringOptional(settings, "metricsHost").value_or("127.0.0.1");
+    if (!NapiUtil::isUndefined(settings, "affinity")) {
+        affinity = AffinitySettings(settings.Get("affinity").As<Napi::Object>());
+    }
+
+    // transitions to preload
+    if (!NapiUtil::isUndefined(settings, "transitions")) {
+        auto array = settings.Get("transitions").As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); ++i) {
+            transitions.emplace_back(array.Get(i).As<Napi::Object>());
+        }
+    }
 
     // video settings
     auto videoSettings = settings.Get("video").As<Napi::Object>();
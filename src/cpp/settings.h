@@ -2,6 +2,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <napi.h>
 
 struct VideoSettings {
@@ -19,6 +20,111 @@ struct AudioSettings {
     int sampleRate;
 };
 
+struct TransitionSettings {
+    explicit TransitionSettings(const Napi::Object& transitionSettings);
+    std::string type;
+    std::string settingsJson;
+};
+
+struct DisplaySettings {
+    DisplaySettings();
+    explicit DisplaySettings(const Napi::Object& displaySettings);
+    bool multiview;
+    int columns;
+    int fps;
+};
+
+// SRT transport options, added to srt:// urls as FFmpeg libsrt options.
+struct SrtSettings {
+    SrtSettings();
+    explicit SrtSettings(const Napi::Object& srtSettings);
+    bool equals(const SrtSettings &settings) const;
+    std::string apply(const std::string &url) const;
+    int latencyMs;
+    std::string passphrase;
+    std::string mode;
+    std::string streamId;
+};
+
+// Segmented recording, HLS playlist (.m3u8) with fMP4 segments, or DASH
+// manifest (.mpd) with CMAF segments and optional low latency chunks.
+struct SegmentSettings {
+    explicit SegmentSettings(const Napi::Object& segmentSettings);
+    bool equals(const std::shared_ptr<SegmentSettings> &settings) const;
+    std::string getMuxerSettings() const;
+    std::string path;
+    int segmentSec;
+    int partMs;
+    int windowSize;
+    bool deleteSegments;
+};
+
+struct EncoderBenchmarkSettings {
+    explicit EncoderBenchmarkSettings(const Napi::Object& benchmarkSettings);
+    struct Candidate {
+        std::string encoderId;
+        std::string settingsJson;
+    };
+    std::vector<Candidate> candidates;
+    int width;
+    int height;
+    int bitrateKbps;
+    int durationSec;
+};
+
+// Core sets per thread class, like "0-7,16". Empty leaves the class unpinned.
+struct AffinitySettings {
+    AffinitySettings() = default;
+    explicit AffinitySettings(const Napi::Object& affinitySettings);
+    std::string render;
+    std::string audio;
+    std::string encoder;
+    std::string transcoder;
+    std::string output;
+    std::string control;
+};
+
+class OutputSettings;
+
+struct OffscreenDisplaySettings {
+    explicit OffscreenDisplaySettings(const Napi::Object& offscreenDisplaySettings);
+    int width;
+    int height;
+    int fps;
+    int columns;
+    std::shared_ptr<OutputSettings> output;
+};
+
+struct FrameTapSettings {
+    explicit FrameTapSettings(const Napi::Object& frameTapSettings);
+    std::string name;
+    std::string offscreenDisplay; // Empty for the program output
+    std::string videoFormat;
+    int width;
+    int height;
+    bool audio;
+    int slots;
+};
+
+struct FrameSubscriptionSettings {
+    explicit FrameSubscriptionSettings(const Napi::Object& frameSubscriptionSettings);
+    std::string offscreenDisplay; // Empty for the program output
+    std::string format;
+    int width;
+    int fps;
+    int poolSize;
+};
+
+// A display source is a scene, or a source of a scene. A plain string id
+// has no scene id and is looked up in all scenes.
+struct DisplaySource {
+    explicit DisplaySource(const Napi::Value& displaySource);
+    std::string sceneId;
+    std::string sourceId;
+
+    static std::vector<DisplaySource> fromArray(const Napi::Array& array);
+};
+
 class OutputSettings {
 
 public:
@@ -35,13 +141,46 @@ public:
     std::string profile;
     std::string tune;
     std::string x264opts;
+    std::string videoEncoder;
+    std::string videoEncoderSettingsJson;
+    std::string encoderCores;
+    std::string threadCores;
     int videoBitrateKbps;
     int audioBitrateKbps;
     uint32_t delaySec;
     int mixers;
     bool recordEnable;
     std::string recordFilePath;
+    std::string recordWriter;
+    int recordBufferMb;
+    std::string recordFsync;
+    int recordFsyncIntervalMs;
     bool enableAbsoluteTimestamp;
+    bool dynamicBitrate;
+    int minVideoBitrateKbps;
+    int maxVideoBitrateKbps;
+    bool autoReconnect;
+    int reconnectDelayMs;
+    int reconnectMaxDelayMs;
+    int reconnectMaxRetries;
+    SrtSettings srt;
+    std::shared_ptr<SegmentSettings> segment;
+    int replaySec;
+    int replayMaxMemoryMb;
+};
+
+struct PipelineBenchmarkSettings {
+    explicit PipelineBenchmarkSettings(const Napi::Object& benchmarkSettings);
+    int sources;
+    std::string input; // Media file looped by every source, a synthetic test pattern when empty
+    int inputWidth;
+    int inputHeight;
+    int inputFps;
+    std::shared_ptr<OutputSettings> output; // The url is replaced by the sink
+    std::string sink; // "null" or "file"
+    std::string outputDir;
+    int warmupSec;
+    int durationSec;
 };
 
 class Settings {
@@ -56,6 +195,16 @@ public:
     uint32_t timestampFontHeight;
     uint32_t multiSourceSyncThreshold;
     uint32_t multiSourceSyncMaxDistance;
+    uint32_t sourcePoolGraceSec;
+    bool shareSources;
+    uint32_t sceneReadyTimeoutMs;
+    uint32_t tBarSmoothingMs;
+    int encoderCpuCores;
+    int64_t encoderCpuPixels;
+    AffinitySettings affinity;
+    int metricsPort;
+    std::string metricsHost;
+    std::vector<TransitionSettings> transitions;
     VideoSettings *video;
     AudioSettings *audio;
 };
\ No newline at end of file
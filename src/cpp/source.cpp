@@ -1,6 +1,7 @@
 #include "source.h"
 #include <utility>
 #include "callback.h"
+#include "metrics.h"
 #include "utils.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -43,6 +44,7 @@ static void write_png_callback(void *context, void *data, int size) {
 
 void Source::volmeter_callback(void *param, const float *magnitude, const float *peak, const float *input_peak) {
     auto source = static_cast<Source *>(param);
+    Metrics::countVolmeterCallback();
     auto callback = Callback::getVolmeterCallback();
     if (callback && source->obs_volmeter) {
         int channels = obs_volmeter_get_nr_channels(source->obs_volmeter);
@@ -112,16 +114,18 @@ void Source::source_deactivate_callback(void *param, calldata_t *data) {
     }
 }
 
-Source::Source(std::string &id, std::string &sceneId, obs_scene_t *obs_scene, Settings *studioSettings,
-               const Napi::Object &settings) :
+Source::Source(std::string &id, std::string &sceneId, obs_scene_t *obs_scene, SourcePool *pool,
+               Settings *studioSettings, const Napi::Object &settings) :
         id(id),
         sceneId(sceneId),
         output(nullptr),
+        pool(pool),
         obs_scene(obs_scene),
         obs_source(nullptr),
         obs_scene_item(nullptr),
         obs_volmeter(nullptr),
         obs_fader(nullptr),
+        handle(std::make_shared<SourceHandle>()),
         transcoder(nullptr) {
     name = NapiUtil::getString(settings, "name");
     type = Source::getSourceType(NapiUtil::getString(settings, "type"));
@@ -135,7 +139,14 @@ Source::Source(std::string &id, std::string &sceneId, obs_scene_t *obs_scene, Se
     audioLock = NapiUtil::getBooleanOptional(settings, "audioLock").value_or(false);
     monitor = NapiUtil::getBooleanOptional(settings, "monitor").value_or(false);
     mixers = NapiUtil::getIntOptional(settings, "mixers").value_or(DEFAULT_AUDIO_MIXER);
+    if (!NapiUtil::isUndefined(settings, "srt")) {
+        srt = SrtSettings(settings.Get("srt").As<Napi::Object>());
+    }
     showTimestamp = studioSettings->showTimestamp;
+    shareSource = studioSettings->shareSources;
+    onProgram = false;
+    prepared = false;
+    prepareTimestamp = 0;
     if (!settings.Get("output").IsUndefined() && !settings.Get("output").IsNull()) {
         output = std::make_shared<OutputSettings>(settings.Get("output").As<Napi::Object>());
     }
@@ -202,6 +213,13 @@ void Source::update(const Napi::Object &settings) {
             restart = true;
         }
     }
+    if (!NapiUtil::isUndefined(settings, "srt")) {
+        auto value = SrtSettings(settings.Get("srt").As<Napi::Object>());
+        if (!srt.equals(value)) {
+            srt = value;
+            restart = true;
+        }
+    }
     if (!NapiUtil::isUndefined(settings, "volume")) {
         auto value = NapiUtil::getInt(settings, "volume");
         if (volume != value) {
@@ -277,6 +295,14 @@ Napi::Object Source::toNapiObject(Napi::Env env) {
     result.Set("monitor", monitor);
     result.Set("audioLock", audioLock);
     result.Set("mixers", mixers);
+    if (url.rfind("srt://", 0) == 0) {
+        auto srtSettings = Napi::Object::New(env);
+        srtSettings.Set("latencyMs", srt.latencyMs);
+        srtSettings.Set("passphrase", srt.passphrase);
+        srtSettings.Set("mode", srt.mode);
+        srtSettings.Set("streamId", srt.streamId);
+        result.Set("srt", srtSettings);
+    }
     return result;
 }
 
@@ -293,7 +319,7 @@ uint64_t Source::getServerTimestamp() {
 void Source::start() {
     obs_data_t *obs_data = obs_data_create();
     obs_data_set_bool(obs_data, "is_local_file", type == SOURCE_TYPE_MEDIA);
-    obs_data_set_string(obs_data, type == SOURCE_TYPE_MEDIA ? "local_file" : "input", url.c_str());
+    obs_data_set_string(obs_data, type == SOURCE_TYPE_MEDIA ? "local_file" : "input", srt.apply(url).c_str());
     obs_data_set_bool(obs_data, "looping", type == SOURCE_TYPE_MEDIA);
     obs_data_set_bool(obs_data, "hw_decode", hardwareDecoder);
     obs_data_set_bool(obs_data, "close_when_inactive", false);  // make source always read
@@ -301,7 +327,10 @@ void Source::start() {
     obs_data_set_bool(obs_data, "clear_on_media_end", false);
     obs_data_set_int(obs_data, "buffering_mb", bufferingMb);
     obs_data_set_int(obs_data, "reconnect_delay_sec", reconnectDelaySec);
-    obs_source = obs_source_create("ffmpeg_source", this->id.c_str(), obs_data, nullptr);
+    // Media sources played on active need their own playback position, never share them.
+    bool share = shareSource && !(type == SOURCE_TYPE_MEDIA && playOnActive);
+    poolKey = getPoolKey();
+    obs_source = pool->acquire(poolKey, id, obs_data, share);
     obs_data_release(obs_data);
 
     if (!obs_source) {
@@ -309,6 +338,7 @@ void Source::start() {
     }
 
     obs_source_set_async_unbuffered(obs_source, asyncUnbuffered);
+    handle->reset(obs_source);
 
     if (showTimestamp) {
         obs_source_show_timestamp(obs_source, true);
@@ -352,10 +382,7 @@ void Source::start() {
     }
 
     // audio
-    setVolume(volume);
-    setAudioLock(audioLock);
-    setMonitor(monitor);
-    setMixers(mixers);
+    applyAudio();
 
     signal_handler_t *handler = obs_source_get_signal_handler(obs_source);
     signal_handler_connect(handler, "activate", source_activate_callback, this);
@@ -365,7 +392,7 @@ void Source::start() {
     startOutput();
 }
 
-void Source::stop() {
+void Source::stop(bool reuse) {
     stopOutput();
 
     signal_handler_t *handler = obs_source_get_signal_handler(obs_source);
@@ -376,25 +403,37 @@ void Source::stop() {
         obs_volmeter_remove_callback(obs_volmeter, volmeter_callback, this);
         obs_volmeter_detach_source(obs_volmeter);
         obs_volmeter_destroy(obs_volmeter);
+        obs_volmeter = nullptr;
     }
     if (obs_fader) {
         obs_fader_detach_source(obs_fader);
         obs_fader_destroy(obs_fader);
+        obs_fader = nullptr;
     }
 
     // obs_sceneitem_remove will call obs_sceneitem_release internally,
     // so it's no need to call obs_sceneitem_release.
     obs_sceneitem_remove(obs_scene_item);
-    obs_source_remove(obs_source);
-    obs_source_release(obs_source);
+    handle->reset(nullptr);
+    pool->release(poolKey, obs_source, reuse);
     obs_source = nullptr;
     obs_scene_item = nullptr;
 }
 
+std::shared_ptr<SourceHandle> Source::getHandle() {
+    return handle;
+}
+
 void Source::startOutput() {
     if (output) {
         transcoder = new SourceTranscoder();
-        transcoder->start(this);
+        try {
+            transcoder->start(id, obs_source, output, Output::metricsLabels("source", sceneId, id, ""));
+        } catch (...) {
+            delete transcoder;
+            transcoder = nullptr;
+            throw;
+        }
     }
 }
 
@@ -407,10 +446,76 @@ void Source::stopOutput() {
 }
 
 void Source::restart() {
-    stop();
+    if (isShared()) {
+        // Other scenes are still using the input, reconnect it in place.
+        obs_source_media_restart(obs_source);
+        return;
+    }
+    // Restart is asked to reconnect the input, so never hand back a pooled one.
+    stop(false);
     start();
 }
 
+std::string Source::getPoolKey() {
+    return Source::getSourceTypeString(type) + "|" +
+           srt.apply(url) + "|" +
+           std::to_string(hardwareDecoder) + "|" +
+           std::to_string(asyncUnbuffered) + "|" +
+           std::to_string(bufferingMb) + "|" +
+           std::to_string(reconnectDelaySec);
+}
+
+bool Source::isShared() {
+    return pool->getShareCount(poolKey, obs_source) > 1;
+}
+
+bool Source::ownsAudio() {
+    // A shared obs source has only one volume and mixer setting, it follows
+    // the scene which is currently on program.
+    return onProgram || !isShared();
+}
+
+void Source::applyAudio() {
+    setVolume(volume);
+    setAudioLock(audioLock);
+    setMonitor(monitor);
+    setMixers(mixers);
+}
+
+void Source::setOnProgram(bool onProgram) {
+    this->onProgram = onProgram;
+    if (onProgram) {
+        applyAudio();
+    }
+}
+
+void Source::prepare() {
+    prepared = true;
+    prepareTimestamp = getTimestamp();
+    // Don't wait for the transition to activate the source, start decoding now.
+    if (type == SOURCE_TYPE_MEDIA && playOnActive) {
+        play();
+    }
+}
+
+void Source::unprepare(bool rewind) {
+    if (!prepared) {
+        return;
+    }
+    prepared = false;
+    if (rewind && type == SOURCE_TYPE_MEDIA && playOnActive && obs_source && !obs_source_active(obs_source)) {
+        stopToBeginning();
+    }
+}
+
+bool Source::isReady() {
+    if (!obs_source) {
+        return false;
+    }
+    uint64_t timestamp = getTimestamp();
+    return timestamp > 0 && (!prepared || timestamp != prepareTimestamp);
+}
+
 void Source::play() {
     if (obs_source) {
         obs_source_media_play_pause(obs_source, false);
@@ -425,18 +530,20 @@ void Source::stopToBeginning() {
 }
 
 void Source::setVolume(int volume) {
-    // Set volume in dB
-    obs_fader_set_db(obs_fader, (float) volume);
+    if (obs_fader && ownsAudio()) {
+        // Set volume in dB
+        obs_fader_set_db(obs_fader, (float) volume);
+    }
 }
 
 void Source::setAudioLock(bool audioLock) {
-    if (obs_source) {
+    if (obs_source && ownsAudio()) {
         obs_source_set_audio_lock(obs_source, audioLock);
     }
 }
 
 void Source::setMonitor(bool monitor) {
-    if (obs_source) {
+    if (obs_source && ownsAudio()) {
         if (monitor) {
             obs_source_set_monitoring_type(obs_source, OBS_MONITORING_TYPE_MONITOR_ONLY);
         } else {
@@ -446,7 +553,7 @@ void Source::setMonitor(bool monitor) {
 }
 
 void Source::setMixers(int mixers) {
-    if (obs_source) {
+    if (obs_source && ownsAudio()) {
         obs_source_set_audio_mixers(obs_source, mixers);
     }
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "settings.h"
 #include "source_transcoder.h"
+#include "source_pool.h"
+#include "source_handle.h"
 #include <obs.h>
 #include <string>
 
@@ -21,6 +23,7 @@ public:
     Source(std::string &id,
            std::string &sceneId,
            obs_scene_t *obs_scene,
+           SourcePool *pool,
            Settings *studioSettings,
            const Napi::Object &settings
     );
@@ -38,6 +41,16 @@ public:
 
     uint64_t getServerTimestamp();
 
+    void setOnProgram(bool onProgram);
+
+    void prepare();
+
+    void unprepare(bool rewind);
+
+    bool isReady();
+
+    std::shared_ptr<SourceHandle> getHandle();
+
 private:
     static void volmeter_callback(
             void *param,
@@ -51,7 +64,11 @@ private:
     static void source_deactivate_callback(void *param, calldata_t *data);
 
     void start();
-    void stop();
+    void stop(bool reuse = true);
+    std::string getPoolKey();
+    bool isShared();
+    bool ownsAudio();
+    void applyAudio();
     void startOutput();
     void stopOutput();
 
@@ -78,13 +95,21 @@ private:
     bool monitor;
     int mixers;
     bool showTimestamp;
+    bool shareSource;
+    SrtSettings srt;
+    bool onProgram;
+    bool prepared;
+    uint64_t prepareTimestamp;
     std::shared_ptr<OutputSettings> output;
 
+    SourcePool *pool;
+    std::string poolKey;
     obs_scene_t *obs_scene;
     obs_source_t *obs_source;
     obs_sceneitem_t *obs_scene_item;
     obs_volmeter_t *obs_volmeter;
     obs_fader_t *obs_fader;
+    std::shared_ptr<SourceHandle> handle;
 
     SourceTranscoder *transcoder;
 };
@@ -0,0 +1,54 @@
+#include "source_handle.h"
+
+SourceHandle::SourceHandle(obs_source_t *obs_source) :
+        mtx(),
+        obs_source(obs_source),
+        showing(0) {
+}
+
+SourceHandle::~SourceHandle() {
+    reset(nullptr);
+}
+
+obs_source_t *SourceHandle::getRef() {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (obs_source) {
+        obs_source_addref(obs_source);
+    }
+    return obs_source;
+}
+
+void SourceHandle::reset(obs_source_t *obs_source) {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (this->obs_source == obs_source) {
+        return;
+    }
+    for (int i = 0; i < showing; ++i) {
+        if (this->obs_source) {
+            obs_source_dec_showing(this->obs_source);
+        }
+        if (obs_source) {
+            obs_source_inc_showing(obs_source);
+        }
+    }
+    this->obs_source = obs_source;
+}
+
+void SourceHandle::incShowing() {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (obs_source) {
+        obs_source_inc_showing(obs_source);
+    }
+    showing++;
+}
+
+void SourceHandle::decShowing() {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (showing == 0) {
+        return;
+    }
+    if (obs_source) {
+        obs_source_dec_showing(obs_source);
+    }
+    showing--;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <mutex>
+#include <obs.h>
+
+// Stable reference to the obs source of a scene or a scene source. The
+// owner swaps the obs source when it's recreated, and the showing
+// references taken through the handle are moved to the new source.
+class SourceHandle {
+
+public:
+    explicit SourceHandle(obs_source_t *obs_source = nullptr);
+    ~SourceHandle();
+
+    // Returns a new reference to the current obs source, or nullptr.
+    obs_source_t *getRef();
+
+    void reset(obs_source_t *obs_source);
+
+    void incShowing();
+
+    void decShowing();
+
+private:
+    std::mutex mtx;
+    obs_source_t *obs_source;
+    int showing;
+};
@@ -0,0 +1,157 @@
+#include "source_pool.h"
+#include "affinity.h"
+#include <vector>
+#include <chrono>
+#include <util/platform.h>
+
+SourcePool::SourcePool(Settings *settings) :
+        graceNs((uint64_t) settings->sourcePoolGraceSec * 1000000000ULL),
+        nextIdleId(0),
+        idle(),
+        shared(),
+        mtx(),
+        cv(),
+        expire_thread(),
+        stop(false) {
+    if (graceNs > 0) {
+        expire_thread = std::thread(&SourcePool::expire_callback, this);
+    }
+}
+
+SourcePool::~SourcePool() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_one();
+    if (expire_thread.joinable()) {
+        expire_thread.join();
+    }
+    clear();
+}
+
+obs_source_t *SourcePool::acquire(const std::string &key, const std::string &name, obs_data_t *settings,
+                                  bool share) {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (share) {
+        auto found = shared.find(key);
+        if (found != shared.end()) {
+            found->second.refs++;
+            blog(LOG_INFO, "[%s] share source: %s, refs: %d", name.c_str(),
+                 obs_source_get_name(found->second.obs_source), found->second.refs);
+            return found->second.obs_source;
+        }
+    }
+
+    obs_source_t *obs_source = nullptr;
+    auto it = idle.find(key);
+    if (it != idle.end()) {
+        obs_source = it->second.obs_source;
+        idle.erase(it);
+        blog(LOG_INFO, "[%s] reuse pooled source: %s", name.c_str(), obs_source_get_name(obs_source));
+        obs_source_set_name(obs_source, name.c_str());
+    } else {
+        obs_source = obs_source_create("ffmpeg_source", name.c_str(), settings, nullptr);
+    }
+
+    if (share && obs_source) {
+        shared[key] = SharedSource{
+                .obs_source = obs_source,
+                .refs = 1,
+        };
+    }
+    return obs_source;
+}
+
+void SourcePool::release(const std::string &key, obs_source_t *obs_source, bool reuse) {
+    if (!obs_source) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    auto found = shared.find(key);
+    if (found != shared.end() && found->second.obs_source == obs_source) {
+        if (--found->second.refs > 0) {
+            return;
+        }
+        shared.erase(found);
+    }
+    if (!reuse || graceNs == 0 || stop) {
+        lock.unlock();
+        destroySource(obs_source);
+        return;
+    }
+    // A pooled source isn't in any scene, make sure it's not heard either.
+    obs_source_set_monitoring_type(obs_source, OBS_MONITORING_TYPE_NONE);
+    std::string idleName = "pooled_source_" + std::to_string(nextIdleId++);
+    blog(LOG_INFO, "[%s] pool source as %s", obs_source_get_name(obs_source), idleName.c_str());
+    obs_source_set_name(obs_source, idleName.c_str());
+    idle.insert({key, PooledSource{
+            .obs_source = obs_source,
+            .expireTime = os_gettime_ns() + graceNs,
+    }});
+    lock.unlock();
+    cv.notify_one();
+}
+
+int SourcePool::getShareCount(const std::string &key, obs_source_t *obs_source) {
+    std::unique_lock<std::mutex> lock(mtx);
+    auto found = shared.find(key);
+    if (found == shared.end() || found->second.obs_source != obs_source) {
+        return obs_source ? 1 : 0;
+    }
+    return found->second.refs;
+}
+
+void SourcePool::clear() {
+    std::multimap<std::string, PooledSource> sources;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        sources.swap(idle);
+    }
+    for (const auto &entry : sources) {
+        destroySource(entry.second.obs_source);
+    }
+}
+
+void SourcePool::expire_callback(void *param) {
+    auto *pool = (SourcePool *) param;
+    ThreadPlacement placement(THREAD_CONTROL, "source pool expire");
+    std::unique_lock<std::mutex> lock(pool->mtx);
+    while (!pool->stop) {
+        uint64_t now = os_gettime_ns();
+        uint64_t next = 0;
+        std::vector<obs_source_t *> expired;
+        for (auto it = pool->idle.begin(); it != pool->idle.end();) {
+            if (it->second.expireTime <= now) {
+                expired.push_back(it->second.obs_source);
+                it = pool->idle.erase(it);
+            } else {
+                if (!next || it->second.expireTime < next) {
+                    next = it->second.expireTime;
+                }
+                ++it;
+            }
+        }
+
+        if (!expired.empty()) {
+            lock.unlock();
+            for (auto obs_source : expired) {
+                blog(LOG_INFO, "[%s] pooled source expired", obs_source_get_name(obs_source));
+                destroySource(obs_source);
+            }
+            lock.lock();
+            continue;
+        }
+
+        if (next) {
+            pool->cv.wait_for(lock, std::chrono::nanoseconds(next - now));
+        } else {
+            pool->cv.wait(lock);
+        }
+    }
+}
+
+void SourcePool::destroySource(obs_source_t *obs_source) {
+    obs_source_remove(obs_source);
+    obs_source_release(obs_source);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "settings.h"
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <obs.h>
+
+// Keep released ffmpeg sources decoding for a grace period, so a source
+// re-added with the same input can be attached without reconnecting.
+// Shared sources with the same key are mapped to one obs source, which is
+// added to every scene as a separate scene item.
+class SourcePool {
+
+public:
+    explicit SourcePool(Settings *settings);
+    ~SourcePool();
+
+    obs_source_t *acquire(const std::string &key, const std::string &name, obs_data_t *settings, bool share);
+
+    void release(const std::string &key, obs_source_t *obs_source, bool reuse = true);
+
+    int getShareCount(const std::string &key, obs_source_t *obs_source);
+
+    void clear();
+
+private:
+    struct PooledSource {
+        obs_source_t *obs_source;
+        uint64_t expireTime;
+    };
+
+    struct SharedSource {
+        obs_source_t *obs_source;
+        int refs;
+    };
+
+    static void expire_callback(void *param);
+    static void destroySource(obs_source_t *obs_source);
+
+    uint64_t graceNs;
+    int nextIdleId; // Idle sources get a name of their own, never the one of a live source
+    std::multimap<std::string, PooledSource> idle;
+    std::map<std::string, SharedSource> shared;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread expire_thread;
+    volatile bool stop;
+};
@@ -1,6 +1,8 @@
 #include "source_transcoder.h"
-#include "source.h"
 #include "utils.h"
+#include "affinity.h"
+#include "metrics.h"
+#include "trace.h"
 #include <media-io/video-frame.h>
 #include <util/platform.h>
 
@@ -63,10 +65,13 @@ static void draw_frame_texture(const gs_texrender_t *texrender) {
 }
 
 SourceTranscoder::SourceTranscoder() :
-        source(nullptr),
+        id(),
+        obs_source(nullptr),
+        settings(),
         output(nullptr),
         video(nullptr),
         frame_buf(),
+        frame_arrival_buf(),
         frame_buf_mutex(),
         frame_textures(),
         frame_texrender(nullptr),
@@ -79,6 +84,10 @@ SourceTranscoder::SourceTranscoder() :
         last_frame_ts(0),
         video_stop(false),
         video_thread(),
+        output_frames(0),
+        latency_sampling(false),
+        latency_samples(),
+        latency_mutex(),
         audio(nullptr),
         audio_buf(),
         audio_buf_mutex(),
@@ -89,24 +98,33 @@ SourceTranscoder::SourceTranscoder() :
         timing_mutex() {
 }
 
-void SourceTranscoder::start(Source *s) {
-    source = s;
-    output = new Output(source->output);
+void SourceTranscoder::start(const std::string &sourceId, obs_source_t *source,
+                             std::shared_ptr<OutputSettings> outputSettings, const MetricsWriter::Labels &labels) {
+    id = sourceId;
+    obs_source = source;
+    settings = std::move(outputSettings);
+    output_frames = 0;
+    output = new Output(id, settings, labels);
 
     // video output
     obs_video_info ovi = {};
     obs_get_video_info(&ovi);
 
     video_output_info voi = {};
-    std::string videoOutputName = std::string("source_video_output_") + source->id;
+    std::string videoOutputName = std::string("source_video_output_") + id;
     voi.name = videoOutputName.c_str();
     voi.format = VIDEO_FORMAT_BGRA;
-    voi.width = source->output->width;
-    voi.height = source->output->height;
+    voi.width = settings->width;
+    voi.height = settings->height;
     voi.fps_num = ovi.fps_num;
     voi.fps_den = ovi.fps_den;
     voi.cache_size = 16;
-    video_output_open(&video, &voi);
+    {
+        // The encoders of this source run on the video output thread.
+        ScopedAffinity affinity(settings->encoderCores.empty() ?
+                                Affinity::getCores(THREAD_ENCODER) : parseCoreSet(settings->encoderCores));
+        video_output_open(&video, &voi);
+    }
 
     video_thread = std::thread(&SourceTranscoder::video_output_callback, this);
 
@@ -119,7 +137,7 @@ void SourceTranscoder::start(Source *s) {
     obs_get_audio_info(&oai);
 
     audio_output_info aoi = {};
-    std::string audioOutputName = std::string("source_audio_output_") + source->id;
+    std::string audioOutputName = std::string("source_audio_output_") + id;
     aoi.name = audioOutputName.c_str();
     aoi.samples_per_sec = oai.samples_per_sec;
     aoi.format = AUDIO_FORMAT_FLOAT_PLANAR;
@@ -127,18 +145,45 @@ void SourceTranscoder::start(Source *s) {
     aoi.input_callback = audio_output_callback;
     aoi.input_param = this;
 
-    obs_source_add_audio_capture_callback(source->obs_source, audio_capture_callback, this);
+    obs_source_add_audio_capture_callback(obs_source, audio_capture_callback, this);
 
-    audio_output_open(&audio, &aoi);
+    {
+        ScopedAffinity affinity(Affinity::getCores(THREAD_AUDIO));
+        audio_output_open(&audio, &aoi);
+    }
 
-    output->start(video, audio);
+    try {
+        output->start(video, audio);
+    } catch (...) {
+        // The output already cleaned up after itself, release the rest.
+        stop();
+        throw;
+    }
 
-    signal_handler_t *handler = obs_source_get_signal_handler(source->obs_source);
+    Metrics::addCollector(this, [this, labels](MetricsWriter &writer) {
+        size_t videoFrames;
+        {
+            std::unique_lock<std::mutex> lock(frame_buf_mutex);
+            videoFrames = frame_buf.size / sizeof(void *);
+        }
+        size_t audioSamples;
+        {
+            std::unique_lock<std::mutex> lock(audio_buf_mutex);
+            audioSamples = audio_buf[0].size / sizeof(float);
+        }
+        writer.gauge("obs_node_transcoder_video_buffer_frames", "Decoded frames waiting in the transcoder",
+                     labels, (double) videoFrames);
+        writer.gauge("obs_node_transcoder_audio_buffer_seconds", "Audio waiting in the transcoder",
+                     labels, (double) audioSamples / audio_output_get_sample_rate(audio));
+    });
+
+    signal_handler_t *handler = obs_source_get_signal_handler(obs_source);
     signal_handler_connect(handler, "media_get_frame", source_media_get_frame_callback, this);
 }
 
 void SourceTranscoder::stop() {
-    signal_handler_t *handler = obs_source_get_signal_handler(source->obs_source);
+    Metrics::removeCollector(this);
+    signal_handler_t *handler = obs_source_get_signal_handler(obs_source);
     signal_handler_disconnect(handler, "media_get_frame", source_media_get_frame_callback, this);
 
     // output stop
@@ -153,6 +198,7 @@ void SourceTranscoder::stop() {
 
     video_output_stop(video);
     video_output_close(video);
+    video = nullptr;
 
     obs_enter_graphics();
     if (video_stagesurface) {
@@ -182,7 +228,7 @@ void SourceTranscoder::stop() {
     last_frame_ts = 0;
 
     // audio stop
-    obs_source_remove_audio_capture_callback(source->obs_source, audio_capture_callback, this);
+    obs_source_remove_audio_capture_callback(obs_source, audio_capture_callback, this);
 
     audio_output_close(audio);
 
@@ -193,7 +239,31 @@ void SourceTranscoder::stop() {
     timing_adjust = 0;
 }
 
+uint64_t SourceTranscoder::getOutputFrames() {
+    return output_frames;
+}
+
+uint32_t SourceTranscoder::getSkippedFrames() {
+    return video ? video_output_get_skipped_frames(video) : 0;
+}
+
+void SourceTranscoder::setLatencySampling(bool enable) {
+    std::unique_lock<std::mutex> lock(latency_mutex);
+    if (enable) {
+        latency_samples.clear();
+    }
+    latency_sampling = enable;
+}
+
+std::vector<uint64_t> SourceTranscoder::takeLatencySamples() {
+    std::unique_lock<std::mutex> lock(latency_mutex);
+    std::vector<uint64_t> samples;
+    samples.swap(latency_samples);
+    return samples;
+}
+
 void SourceTranscoder::source_media_get_frame_callback(void *param, calldata_t *data) {
+    TRACE_SCOPE("source_media_get_frame_callback");
     auto transcoder = (SourceTranscoder *) param;
     auto *frame = (obs_source_frame *) calldata_ptr(data, "frame");
 
@@ -203,6 +273,7 @@ void SourceTranscoder::source_media_get_frame_callback(void *param, calldata_t *
 
     obs_source_frame *new_frame = obs_source_frame_create(frame->format, frame->width, frame->height);
     obs_source_frame_copy(new_frame, frame);
+    uint64_t arrival = os_gettime_ns();
 
     const struct video_output_info *voi = video_output_get_info(transcoder->video);
     uint64_t max_buffer_frames = util_mul_div64(VIDEO_BUFFER_SIZE, voi->fps_num, voi->fps_den * 1000000000UL);
@@ -210,19 +281,23 @@ void SourceTranscoder::source_media_get_frame_callback(void *param, calldata_t *
     transcoder->frame_buf_mutex.lock();
 
     if (transcoder->frame_buf.size / sizeof(void *) >= max_buffer_frames) {
-        blog(LOG_INFO, "[%s] exceed max video buffer: %llu", transcoder->source->id.c_str(), max_buffer_frames);
+        blog(LOG_INFO, "[%s] exceed max video buffer: %llu", transcoder->id.c_str(), max_buffer_frames);
         transcoder->reset_video();
     }
 
     circlebuf_push_back(&transcoder->frame_buf, &new_frame, sizeof(void *));
+    circlebuf_push_back(&transcoder->frame_arrival_buf, &arrival, sizeof(arrival));
     transcoder->frame_buf_mutex.unlock();
 }
 
 void SourceTranscoder::video_output_callback(void *param) {
     auto *transcoder = (SourceTranscoder *) param;
+    ThreadPlacement placement(THREAD_TRANSCODER, "transcoder " + transcoder->id,
+                              transcoder->settings->threadCores);
     const struct video_output_info *voi = video_output_get_info(transcoder->video);
     uint64_t interval = util_mul_div64(1000000000UL, voi->fps_den, voi->fps_num);
     transcoder->last_video_time = os_gettime_ns();
+    uint64_t last_arrival = 0;
 
     while (!transcoder->video_stop) {
         uint64_t video_time = transcoder->last_video_time + interval;
@@ -233,14 +308,18 @@ void SourceTranscoder::video_output_callback(void *param) {
             count = (int) ((os_gettime_ns() - transcoder->last_video_time) / interval);
             video_time = transcoder->last_video_time + interval * count;
             if (count > 1) {
-                blog(LOG_INFO, "[%s] video lagged: %d", transcoder->source->id.c_str(), count);
+                blog(LOG_INFO, "[%s] video lagged: %d", transcoder->id.c_str(), count);
             }
         }
 
-        obs_enter_graphics();
+        TRACE_SCOPE("video_output_callback");
+        {
+            TRACE_SCOPE("obs_enter_graphics");
+            obs_enter_graphics();
+        }
 
-        int output_width = transcoder->source->output->width;
-        int output_height = transcoder->source->output->height;
+        int output_width = transcoder->settings->width;
+        int output_height = transcoder->settings->height;
 
         // initialize textrender
         if (!transcoder->video_texrender) {
@@ -260,9 +339,11 @@ void SourceTranscoder::video_output_callback(void *param) {
             gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
 
             // render frame
+            uint64_t arrival = 0;
             transcoder->frame_buf_mutex.lock();
             auto frame = transcoder->get_closest_frame(video_time);
             if (frame) {
+                circlebuf_peek_front(&transcoder->frame_arrival_buf, &arrival, sizeof(arrival));
                 transcoder->timing_mutex.lock();
                 transcoder->timing_adjust = video_time - frame->timestamp;
                 transcoder->timing_mutex.unlock();
@@ -273,6 +354,7 @@ void SourceTranscoder::video_output_callback(void *param) {
             // copy rendered texture to output frame
             struct video_frame output_frame = {};
             if (video_output_lock_frame(transcoder->video, &output_frame, count, video_time)) {
+                TRACE_SCOPE("stage_readback");
                 gs_stage_texture(transcoder->video_stagesurface, gs_texrender_get_texture(transcoder->video_texrender));
                 uint8_t *video_data = nullptr;
                 uint32_t video_linesize;
@@ -289,6 +371,14 @@ void SourceTranscoder::video_output_callback(void *param) {
                     gs_stagesurface_unmap(transcoder->video_stagesurface);
                 }
                 video_output_unlock_frame(transcoder->video);
+                transcoder->output_frames++;
+
+                // A frame is repeated while the decoder is behind, only its first readback counts.
+                if (transcoder->latency_sampling && arrival && arrival != last_arrival) {
+                    std::unique_lock<std::mutex> lock(transcoder->latency_mutex);
+                    transcoder->latency_samples.push_back(os_gettime_ns() - arrival);
+                }
+                last_arrival = arrival;
             }
 
             gs_blend_state_pop();
@@ -304,6 +394,7 @@ void SourceTranscoder::audio_capture_callback(void *param, obs_source_t *source,
                                               bool muted) {
     UNUSED_PARAMETER(source);
     UNUSED_PARAMETER(muted);
+    TRACE_SCOPE("audio_capture_callback");
 
     auto transcoder = (SourceTranscoder *) param;
 
@@ -326,7 +417,7 @@ void SourceTranscoder::audio_capture_callback(void *param, obs_source_t *source,
     if (!transcoder->audio_time || current_audio_time < transcoder->audio_time ||
         current_audio_time - transcoder->audio_time > AUDIO_BUFFER_SIZE) {
         blog(LOG_INFO, "[%s] audio buffer reset, audio time: %llu, current audio time: %llu",
-             transcoder->source->id.c_str(), transcoder->audio_time, current_audio_time);
+             transcoder->id.c_str(), transcoder->audio_time, current_audio_time);
         transcoder->reset_audio();
         transcoder->audio_time = current_audio_time;
         transcoder->last_audio_time = current_audio_time;
@@ -335,7 +426,7 @@ void SourceTranscoder::audio_capture_callback(void *param, obs_source_t *source,
     uint64_t diff = uint64_diff(transcoder->last_audio_time, current_audio_time);
     if (diff > AUDIO_SMOOTH_THRESHOLD) {
         blog(LOG_DEBUG, "[%s] audio buffer placement: %llu, audio time: %llu, current audio time: %llu",
-             transcoder->source->id.c_str(), diff, transcoder->audio_time, current_audio_time);
+             transcoder->id.c_str(), diff, transcoder->audio_time, current_audio_time);
         size_t buf_placement = ns_to_audio_frames(rate, current_audio_time - transcoder->audio_time) * sizeof(float);
         for (size_t i = 0; i < channels; i++) {
             circlebuf_place(&transcoder->audio_buf[i], buf_placement, audio_data->data[i], audio_size);
@@ -361,6 +452,7 @@ bool SourceTranscoder::audio_output_callback(
         uint32_t mixers,
         struct audio_output_data *mixes) {
     UNUSED_PARAMETER(mixers);
+    TRACE_SCOPE("audio_output_callback");
 
     auto transcoder = (SourceTranscoder *) param;
     size_t channels = audio_output_get_channels(transcoder->audio);
@@ -372,7 +464,7 @@ bool SourceTranscoder::audio_output_callback(
     circlebuf_push_back(&transcoder->audio_timestamp_buf, &ts, sizeof(ts));
     circlebuf_peek_front(&transcoder->audio_timestamp_buf, &ts, sizeof(ts));
 
-    bool paused = obs_source_media_get_state(transcoder->source->obs_source) == OBS_MEDIA_STATE_PAUSED;
+    bool paused = obs_source_media_get_state(transcoder->obs_source) == OBS_MEDIA_STATE_PAUSED;
     bool result = false;
 
     if (!transcoder->audio_time || paused) {
@@ -382,7 +474,7 @@ bool SourceTranscoder::audio_output_callback(
     } else if (transcoder->audio_time >= ts.end) {
         // audio go forward, send mute
         blog(LOG_DEBUG, "[%s] audio go forward, audio time: %llu, ts.end: %llu",
-             transcoder->source->id.c_str(), transcoder->audio_time, ts.end);
+             transcoder->id.c_str(), transcoder->audio_time, ts.end);
         result = true;
     } else {
         size_t buffer_size = transcoder->audio_buf[0].size;
@@ -431,6 +523,7 @@ bool SourceTranscoder::audio_output_callback(
 }
 
 obs_source_frame *SourceTranscoder::get_closest_frame(uint64_t video_time) {
+    TRACE_SCOPE("get_closest_frame");
     if (!frame_buf.size) {
         return nullptr;
     }
@@ -451,10 +544,11 @@ obs_source_frame *SourceTranscoder::get_closest_frame(uint64_t video_time) {
     while (frame_ts > frame->timestamp && frame_buf.size > sizeof(void *)) {
         uint64_t ts = frame->timestamp;
         circlebuf_pop_front(&frame_buf, &frame, sizeof(void *));
+        circlebuf_pop_front(&frame_arrival_buf, nullptr, sizeof(uint64_t));
         obs_source_frame_destroy(frame);
         circlebuf_peek_front(&frame_buf, &frame, sizeof(void *));
         if (uint64_diff(ts, frame->timestamp) > VIDEO_JUMP_THRESHOLD) {
-            blog(LOG_DEBUG, "[%s] video jump: %llu -> %llu", source->id.c_str(), ts, frame->timestamp);
+            blog(LOG_DEBUG, "[%s] video jump: %llu -> %llu", id.c_str(), ts, frame->timestamp);
             frame_ts = frame->timestamp;
             break;
         }
@@ -469,6 +563,7 @@ void SourceTranscoder::reset_video() {
         circlebuf_pop_front(&frame_buf, &frame, sizeof(void *));
         obs_source_frame_destroy(frame);
     }
+    circlebuf_pop_front(&frame_arrival_buf, nullptr, frame_arrival_buf.size);
     last_frame_ts = 0;
 }
 
@@ -481,6 +576,7 @@ void SourceTranscoder::reset_audio() {
 }
 
 void SourceTranscoder::render_frame(obs_source_frame *frame, int output_width, int output_height) {
+    TRACE_SCOPE("render_frame");
     const enum gs_color_format format = convert_video_format(frame->format);
     if (frame_textures[0] && (
             frame->width != texture_width ||
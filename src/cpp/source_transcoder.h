@@ -1,25 +1,38 @@
 #pragma once
 
 #include "output.h"
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 #include <obs.h>
 #include <util/circlebuf.h>
 #include <media-io/video-scaler.h>
 #include <media-io/audio-resampler.h>
 
-class Source;
-
 class SourceTranscoder {
 
 public:
     SourceTranscoder();
 
-    void start(Source *source);
+    void start(const std::string &sourceId, obs_source_t *source, std::shared_ptr<OutputSettings> outputSettings,
+               const MetricsWriter::Labels &labels);
 
     void stop();
 
+    // Frames handed to the encoders since start.
+    uint64_t getOutputFrames();
+
+    uint32_t getSkippedFrames();
+
+    // Keeps the time from a frame arriving from the decoder to its readback
+    // into the output, for the frames rendered while sampling is on.
+    void setLatencySampling(bool enable);
+
+    std::vector<uint64_t> takeLatencySamples();
+
 private:
     static void source_media_get_frame_callback(
             void *param,
@@ -51,11 +64,14 @@ private:
 
     void render_frame(obs_source_frame *frame, int output_width, int output_height);
 
-    Source *source;
+    std::string id;
+    obs_source_t *obs_source;
+    std::shared_ptr<OutputSettings> settings;
     Output *output;
 
     video_t *video;
     circlebuf frame_buf;
+    circlebuf frame_arrival_buf; // Arrival time of each frame in frame_buf
     std::mutex frame_buf_mutex;
     gs_texture_t *frame_textures[MAX_AV_PLANES];
     gs_texrender_t *frame_texrender;
@@ -68,6 +84,10 @@ private:
     uint64_t last_frame_ts;
     std::thread video_thread;
     volatile bool video_stop;
+    std::atomic<uint64_t> output_frames;
+    std::atomic<bool> latency_sampling;
+    std::vector<uint64_t> latency_samples;
+    std::mutex latency_mutex;
 
     audio_t *audio;
     circlebuf audio_buf[MAX_AUDIO_CHANNELS];
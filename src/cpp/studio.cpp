@@ -1,5 +1,8 @@
 #include "studio.h"
 #include "utils.h"
+#include "encoder_budget.h"
+#include "affinity.h"
+#include "metrics.h"
 #include <mutex>
 #include <obs.h>
 #include <util/platform.h>
@@ -10,6 +13,7 @@ struct DelaySwitchData {
     std::string transitionType;
     int transitionMs;
     uint64_t timestamp;
+    bool waitReady;
 };
 
 #define MAX_SWITCH_DELAY 5000000000
@@ -17,15 +21,23 @@ struct DelaySwitchData {
 std::mutex scenes_mtx;
 std::string Studio::obsPath;
 std::function<bool(std::function<void()>)> Studio::cef_queue_task_callback;
+std::mutex Studio::benchmark_mtx;
+std::condition_variable Studio::benchmark_cv;
+int Studio::runningBenchmarks = 0;
+bool Studio::abortBenchmarks = false;
 
 Studio::Studio(Settings *settings) :
           settings(settings),
+          sourcePool(nullptr),
+          previewCache(nullptr),
+          nextSubscriptionId(0),
           currentScene(nullptr),
           outputs(),
           delay_switch_thread(),
           delay_switch_queue(),
           stop(false),
           tBarActive(false),
+          tBarController(nullptr),
           overlays() {
 }
 
@@ -40,12 +52,20 @@ void Studio::startup() {
         setCurrentPath(currentWorkDir);
     };
 
+    {
+        std::unique_lock<std::mutex> lock(benchmark_mtx);
+        abortBenchmarks = false;
+    }
+
     try {
         obs_startup(settings->locale.c_str(), nullptr, nullptr);
         if (!obs_initialized()) {
             throw std::runtime_error("Failed to startup obs studio.");
         }
 
+        // libobs threads inherit the cores of the thread creating them
+        Affinity::configure(settings->affinity);
+
         // reset video
         if (settings->video) {
             obs_video_info ovi = {};
@@ -65,6 +85,7 @@ void Studio::startup() {
             ovi.output_height = settings->video->outputHeight;
             ovi.gpu_conversion = true; // always be true for the OBS issue
 
+            ScopedAffinity affinity(Affinity::getCores(THREAD_RENDER));
             int result = obs_reset_video(&ovi);
             if (result != OBS_VIDEO_SUCCESS) {
                 // Try OpenGL if DirectX fails on windows
@@ -82,11 +103,14 @@ void Studio::startup() {
             memset(&oai, 0, sizeof(oai));
             oai.samples_per_sec = settings->audio->sampleRate;
             oai.speakers = SPEAKERS_STEREO;
+            ScopedAffinity affinity(Affinity::getCores(THREAD_AUDIO));
             if (!obs_reset_audio(&oai)) {
                 throw std::runtime_error("Failed to reset audio");
             }
         }
 
+        tBarController = new TBarController(settings);
+
         if (settings->showTimestamp) {
             font_rasterizer_initialize(settings->timestampFontPath.c_str(), settings->timestampFontHeight);
         }
@@ -117,6 +141,16 @@ void Studio::startup() {
 #endif
 
         obs_post_load_modules();
+        EncoderBudget::setCores(settings->encoderCpuCores, settings->encoderCpuPixels);
+        PacketOutput::registerOutput();
+        RecordWriter::registerOutput();
+
+        sourcePool = new SourcePool(settings);
+        previewCache = new PreviewCache();
+
+        for (const auto &transition : settings->transitions) {
+            loadTransition(transition.type, transition.settingsJson);
+        }
 
         for (auto output : outputs) {
             output.second->start(obs_get_video(), obs_get_audio());
@@ -128,6 +162,10 @@ void Studio::startup() {
         obs_set_multi_source_sync_adjust_threshold_ms(settings->multiSourceSyncThreshold);
         obs_set_multi_source_sync_max_distance_ms(settings->multiSourceSyncMaxDistance);
 
+        if (settings->metricsPort > 0) {
+            Metrics::startServer(settings->metricsHost, settings->metricsPort);
+        }
+
         restore();
 
     } catch (...) {
@@ -137,18 +175,40 @@ void Studio::startup() {
 }
 
 void Studio::shutdown() {
+    {
+        std::unique_lock<std::mutex> lock(benchmark_mtx);
+        abortBenchmarks = true;
+        benchmark_cv.notify_all();
+        benchmark_cv.wait(lock, [] { return runningBenchmarks == 0; });
+    }
+    Metrics::stopServer();
     stop = true;
     delay_switch_queue.push(nullptr);
     delay_switch_thread.join();
     for (const auto& scene : scenes) {
         delete scene.second;
     }
+    delete sourcePool;
+    sourcePool = nullptr;
+    delete tBarController;
+    tBarController = nullptr;
     for (const auto& transition : transitions) {
         obs_source_release(transition.second);
     }
+    for (const auto& frameTap : frameTaps) {
+        delete frameTap.second;
+    }
+    for (const auto& subscription : frameSubscriptions) {
+        delete subscription.second;
+    }
     for (const auto& display : displays) {
         delete display.second;
     }
+    for (const auto& display : offscreenDisplays) {
+        delete display.second;
+    }
+    delete previewCache;
+    previewCache = nullptr;
     for (const auto& overlay : overlays) {
         delete overlay.second;
     }
@@ -159,6 +219,9 @@ void Studio::shutdown() {
     scenes.clear();
     transitions.clear();
     displays.clear();
+    offscreenDisplays.clear();
+    frameTaps.clear();
+    frameSubscriptions.clear();
     overlays.clear();
     outputs.clear();
     font_rasterizer_uninitialize();
@@ -168,12 +231,41 @@ void Studio::shutdown() {
     }
 }
 
+void Studio::beginBenchmark() {
+    std::unique_lock<std::mutex> lock(benchmark_mtx);
+    if (abortBenchmarks) {
+        throw std::logic_error("Studio is shut down.");
+    }
+    ++runningBenchmarks;
+}
+
+void Studio::endBenchmark() {
+    std::unique_lock<std::mutex> lock(benchmark_mtx);
+    --runningBenchmarks;
+    benchmark_cv.notify_all();
+}
+
+bool Studio::isBenchmarkAborted() {
+    std::unique_lock<std::mutex> lock(benchmark_mtx);
+    return abortBenchmarks;
+}
+
+bool Studio::benchmarkSleep(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(benchmark_mtx);
+    return !benchmark_cv.wait_for(lock, duration, [] { return abortBenchmarks; });
+}
+
 void Studio::addOutput(const std::string &outputId, std::shared_ptr<OutputSettings> settings) {
     if (outputs.find(outputId) != outputs.end()) {
         throw std::logic_error("Output: " + outputId + " already existed");
     }
-    auto output = new Output(settings);
-    output->start(obs_get_video(), obs_get_audio());
+    auto output = new Output(outputId, settings, Output::metricsLabels("studio", "", "", outputId));
+    try {
+        output->start(obs_get_video(), obs_get_audio());
+    } catch (...) {
+        delete output;
+        throw;
+    }
     this->outputs[outputId] = output;
 }
 
@@ -187,6 +279,40 @@ void Studio::updateOutput(const std::string &outputId, std::shared_ptr<OutputSet
     }
 }
 
+Napi::Object Studio::getOutputStats(Napi::Env env, const std::string &outputId) {
+    auto found = outputs.find(outputId);
+    if (found == outputs.end()) {
+        throw std::logic_error("Can't find output: " + outputId);
+    }
+    return found->second->getStats(env);
+}
+
+void Studio::saveReplay(const std::string &outputId, const std::string &path, Output::ReplayCallback callback) {
+    auto found = outputs.find(outputId);
+    if (found == outputs.end()) {
+        throw std::logic_error("Can't find output: " + outputId);
+    }
+    found->second->saveReplay(path, std::move(callback));
+}
+
+void Studio::playReplay(const std::string &outputId, std::string &sceneId, std::string &sourceId, Napi::Object &settings) {
+    auto found = outputs.find(outputId);
+    if (found == outputs.end()) {
+        throw std::logic_error("Can't find output: " + outputId);
+    }
+    auto path = found->second->getLastReplayPath();
+    if (path.empty()) {
+        throw std::logic_error("No replay saved for output: " + outputId);
+    }
+    // The last replay is played by a media source of the scene.
+    if (NapiUtil::isUndefined(settings, "name")) {
+        settings.Set("name", sourceId);
+    }
+    settings.Set("type", "media");
+    settings.Set("url", path);
+    addSource(sceneId, sourceId, settings);
+}
+
 void Studio::removeOutput(const std::string &outputId) {
     if (outputs.find(outputId) == outputs.end()) {
         return;
@@ -198,13 +324,19 @@ void Studio::removeOutput(const std::string &outputId) {
 }
 
 void Studio::addScene(std::string &sceneId) {
+    if (!sourcePool) {
+        throw std::logic_error("Studio is not started.");
+    }
     std::unique_lock<std::mutex> lock(scenes_mtx);
     int index = (int)scenes.size();
-    auto scene = new Scene(sceneId, index, settings);
+    auto scene = new Scene(sceneId, index, sourcePool, settings);
     scenes[sceneId] = scene;
 }
 
 void Studio::removeScene(std::string &sceneId) {
+    if (!sourcePool) {
+        throw std::logic_error("Studio is not started.");
+    }
     std::unique_lock<std::mutex> lock(scenes_mtx);
     auto scene = scenes[sceneId];
     scenes.erase(sceneId);
@@ -215,6 +347,9 @@ void Studio::removeScene(std::string &sceneId) {
 }
 
 void Studio::addSource(std::string &sceneId, std::string &sourceId, const Napi::Object &settings) {
+    if (!sourcePool) {
+        throw std::logic_error("Studio is not started.");
+    }
     std::unique_lock<std::mutex> lock(scenes_mtx);
     findScene(sceneId)->addSource(sourceId, this->settings, settings);
 }
@@ -225,22 +360,25 @@ Source *Studio::findSource(std::string &sceneId, std::string &sourceId) {
 }
 
 void Studio::switchToScene(std::string &sceneId, std::string &transitionType, int transitionMs, uint64_t timestamp,
-                           int tBarValue) {
+                           int tBarValue, uint64_t tBarTimestamp) {
     if (timestamp > 0) {
         auto data = new DelaySwitchData{
                 .sceneId = sceneId,
                 .transitionType = transitionType,
                 .transitionMs = transitionMs,
                 .timestamp = timestamp,
+                .waitReady = false,
         };
         delay_switch_queue.push(data);
         return;
     }
 
     Scene *next;
+    bool ready;
     {
         std::unique_lock<std::mutex> lock(scenes_mtx);
         next = findScene(sceneId);
+        ready = !next->isPrepared() || next->isReady();
     }
 
     if (!next) {
@@ -255,16 +393,21 @@ void Studio::switchToScene(std::string &sceneId, std::string &transitionType, in
     blog(LOG_INFO, "Start transition: %s -> %s", (currentScene ? currentScene->getId().c_str() : ""),
          next->getId().c_str());
 
-    // Find or create transition
-    auto it = transitions.find(transitionType);
-    if (it == transitions.end()) {
-        transitions[transitionType] = obs_source_create(transitionType.c_str(), transitionType.c_str(), nullptr,
-                                                        nullptr);
-    }
-
-    obs_source_t *transition = transitions[transitionType];
+    obs_source_t *transition = findTransition(transitionType);
 
     if (tBarValue == 0) {
+        if (!ready) {
+            // Let the delay switch thread start the transition once the prepared scene has decoded frames.
+            delay_switch_queue.push(new DelaySwitchData{
+                    .sceneId = sceneId,
+                    .transitionType = transitionType,
+                    .transitionMs = transitionMs,
+                    .timestamp = 0,
+                    .waitReady = true,
+            });
+            return;
+        }
+
         if (currentScene) {
             obs_transition_set(transition, obs_scene_get_source(currentScene->getScene()));
         }
@@ -281,7 +424,7 @@ void Studio::switchToScene(std::string &sceneId, std::string &transitionType, in
             throw std::runtime_error("Failed to start transition.");
         }
 
-        currentScene = next;
+        setCurrentScene(next);
         return;
     } else {
         if (!tBarActive) {
@@ -294,24 +437,107 @@ void Studio::switchToScene(std::string &sceneId, std::string &transitionType, in
             obs_set_output_source(0, transition);
             obs_transition_start(transition, OBS_TRANSITION_MODE_MANUAL, transitionMs,
                                  obs_scene_get_source(next->getScene()));
+            tBarController->start(transition);
             tBarActive = true;
         }
-        obs_transition_set_manual_time(transition, (float)tBarValue / 100);
+        // The position is applied by the controller on the next rendered frames.
+        tBarController->push((float)tBarValue / 100, tBarTimestamp);
 
         if (tBarValue == 100 || tBarValue == 1) {
+            tBarController->finish();
             tBarActive = false;
-            currentScene = next;
+            setCurrentScene(next);
+        }
+    }
+}
+
+void Studio::loadTransition(const std::string &transitionType, const std::string &settingsJson) {
+    obs_data_t *transition_settings = settingsJson.empty() ? nullptr : obs_data_create_from_json(settingsJson.c_str());
+    auto it = transitions.find(transitionType);
+    if (it != transitions.end()) {
+        if (transition_settings) {
+            obs_source_update(it->second, transition_settings);
+            obs_data_release(transition_settings);
+        }
+        return;
+    }
+
+    // Creating transitions loads their assets (stinger media, luma wipe images),
+    // which should be done before the first switch.
+    obs_source_t *transition = obs_source_create(transitionType.c_str(), transitionType.c_str(), transition_settings,
+                                                 nullptr);
+    obs_data_release(transition_settings);
+    if (!transition) {
+        throw std::runtime_error("Failed to create transition " + transitionType);
+    }
+    blog(LOG_INFO, "Transition %s loaded", transitionType.c_str());
+    transitions[transitionType] = transition;
+}
+
+obs_source_t *Studio::findTransition(const std::string &transitionType) {
+    auto it = transitions.find(transitionType);
+    if (it != transitions.end()) {
+        return it->second;
+    }
+    blog(LOG_WARNING, "Transition %s is not preloaded, load it now", transitionType.c_str());
+    loadTransition(transitionType, "");
+    return transitions[transitionType];
+}
+
+void Studio::prepareScene(std::string &sceneId) {
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    Scene *scene = findScene(sceneId);
+    if (scene == currentScene) {
+        return;
+    }
+    scene->prepare();
+}
+
+void Studio::unprepareScene(std::string &sceneId) {
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    Scene *scene = findScene(sceneId);
+    if (scene == currentScene) {
+        return;
+    }
+    scene->unprepare(true);
+}
+
+void Studio::waitSceneReady(std::string &sceneId) {
+    uint64_t deadline = os_gettime_ns() + (uint64_t) settings->sceneReadyTimeoutMs * 1000000ULL;
+    while (os_gettime_ns() < deadline) {
+        {
+            std::unique_lock<std::mutex> lock(scenes_mtx);
+            Scene *scene = findScene(sceneId);
+            if (!scene->isPrepared() || scene->isReady()) {
+                return;
+            }
         }
+        os_sleep_ms(5);
     }
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    blog(LOG_WARNING, "Prepared scene %s is not ready in %u ms, switch anyway", sceneId.c_str(),
+         settings->sceneReadyTimeoutMs);
+    findScene(sceneId)->unprepare(false);
 }
 
 void Studio::delay_switch_callback(void *param) {
     auto *studio = (Studio *) param;
+    ThreadPlacement placement(THREAD_CONTROL, "delay switch");
     while (true) {
         DelaySwitchData * data = studio->delay_switch_queue.pop();
         if (studio->stop) {
             break;
         }
+        if (data->waitReady) {
+            try {
+                studio->waitSceneReady(data->sceneId);
+                studio->switchToScene(data->sceneId, data->transitionType, data->transitionMs, 0);
+            } catch (std::exception &e) {
+                blog(LOG_ERROR, "Failed to switch to prepared scene %s: %s", data->sceneId.c_str(), e.what());
+            }
+            delete data;
+            continue;
+        }
         auto curTimestamp = studio->getSourceTimestamp(data->sceneId);
         int64_t time_diff = data->timestamp - curTimestamp;
         blog(LOG_INFO, "sync switch: client_ts = %lld server_ts = %lld time_diff = %lld",
@@ -342,12 +568,17 @@ void Studio::setCefQueueTaskCallback(std::function<bool(std::function<void()>)>
     Studio::cef_queue_task_callback = callback;
 }
 
-void Studio::createDisplay(std::string &displayName, void *parentHandle, int scaleFactor, const std::vector<std::string> &sourceIds) {
+void Studio::createDisplay(std::string &displayName, void *parentHandle, int scaleFactor, const std::vector<DisplaySource> &displaySources,
+                           const DisplaySettings &displaySettings) {
+#ifdef __linux__
+    throw std::logic_error("Display windows are not supported on Linux, use an offscreen display");
+#endif
     auto found = displays.find(displayName);
     if (found != displays.end()) {
         throw std::logic_error("Display " + displayName + " already existed");
     }
-    auto *display = new Display(parentHandle, scaleFactor, sourceIds);
+    auto handles = findHandles(displaySources);
+    auto *display = new Display(parentHandle, scaleFactor, handles, displaySettings, previewCache);
     displays[displayName] = display;
 }
 
@@ -369,12 +600,136 @@ void Studio::moveDisplay(std::string &displayName, int x, int y, int width, int
     found->second->move(x, y, width, height);
 }
 
-void Studio::updateDisplay(std::string &displayName, const std::vector<std::string> &sourceIds) {
+void Studio::updateDisplay(std::string &displayName, const std::vector<DisplaySource> &displaySources) {
     auto found = displays.find(displayName);
     if (found == displays.end()) {
         throw std::logic_error("Can't find display: " + displayName);
     }
-    found->second->update(sourceIds);
+    found->second->update(findHandles(displaySources));
+}
+
+void Studio::pauseDisplay(std::string &displayName) {
+    auto found = displays.find(displayName);
+    if (found == displays.end()) {
+        throw std::logic_error("Can't find display: " + displayName);
+    }
+    found->second->pause();
+}
+
+void Studio::resumeDisplay(std::string &displayName) {
+    auto found = displays.find(displayName);
+    if (found == displays.end()) {
+        throw std::logic_error("Can't find display: " + displayName);
+    }
+    found->second->resume();
+}
+
+Napi::Object Studio::getDisplayStats(Napi::Env env, std::string &displayName) {
+    auto found = displays.find(displayName);
+    if (found == displays.end()) {
+        throw std::logic_error("Can't find display: " + displayName);
+    }
+    auto result = found->second->getStats(env);
+    // Program output render time, to compare with the time spent on previews.
+    result.Set("outputRenderTimeMs", (double) obs_get_average_frame_time_ns() / 1000000.0);
+    return result;
+}
+
+void Studio::createOffscreenDisplay(std::string &displayName, const std::vector<DisplaySource> &displaySources,
+                                    const OffscreenDisplaySettings &displaySettings) {
+    auto found = offscreenDisplays.find(displayName);
+    if (found != offscreenDisplays.end()) {
+        throw std::logic_error("Offscreen display " + displayName + " already existed");
+    }
+    auto handles = findHandles(displaySources);
+    offscreenDisplays[displayName] = new OffscreenDisplay(displayName, handles, displaySettings, previewCache);
+}
+
+void Studio::destroyOffscreenDisplay(std::string &displayName) {
+    auto found = offscreenDisplays.find(displayName);
+    if (found == offscreenDisplays.end()) {
+        throw std::logic_error("Can't find offscreen display: " + displayName);
+    }
+    for (const auto &frameTap : frameTaps) {
+        if (frameTap.second->getOffscreenDisplay() == displayName) {
+            throw std::logic_error("Offscreen display " + displayName + " is used by frame tap " + frameTap.first);
+        }
+    }
+    for (const auto &subscription : frameSubscriptions) {
+        if (subscription.second->getOffscreenDisplay() == displayName) {
+            throw std::logic_error("Offscreen display " + displayName + " has frame subscriptions");
+        }
+    }
+    OffscreenDisplay *display = found->second;
+    offscreenDisplays.erase(displayName);
+    delete display;
+}
+
+void Studio::updateOffscreenDisplay(std::string &displayName, const std::vector<DisplaySource> &displaySources) {
+    auto found = offscreenDisplays.find(displayName);
+    if (found == offscreenDisplays.end()) {
+        throw std::logic_error("Can't find offscreen display: " + displayName);
+    }
+    found->second->update(findHandles(displaySources));
+}
+
+Napi::Value Studio::getOffscreenDisplayFrame(Napi::Env env, std::string &displayName) {
+    auto found = offscreenDisplays.find(displayName);
+    if (found == offscreenDisplays.end()) {
+        throw std::logic_error("Can't find offscreen display: " + displayName);
+    }
+    return found->second->getFrame(env);
+}
+
+void Studio::addFrameTap(const std::string &frameTapId, const FrameTapSettings &frameTapSettings) {
+    if (frameTaps.find(frameTapId) != frameTaps.end()) {
+        throw std::logic_error("Frame tap: " + frameTapId + " already existed");
+    }
+    video_t *video = obs_get_video();
+    audio_t *audio = frameTapSettings.audio ? obs_get_audio() : nullptr;
+    if (!frameTapSettings.offscreenDisplay.empty()) {
+        auto found = offscreenDisplays.find(frameTapSettings.offscreenDisplay);
+        if (found == offscreenDisplays.end()) {
+            throw std::logic_error("Can't find offscreen display: " + frameTapSettings.offscreenDisplay);
+        }
+        video = found->second->getVideo();
+    }
+    frameTaps[frameTapId] = new FrameTap(frameTapSettings, video, audio);
+}
+
+void Studio::removeFrameTap(const std::string &frameTapId) {
+    auto found = frameTaps.find(frameTapId);
+    if (found == frameTaps.end()) {
+        throw std::logic_error("Can't find frame tap: " + frameTapId);
+    }
+    FrameTap *frameTap = found->second;
+    frameTaps.erase(found);
+    delete frameTap;
+}
+
+int Studio::subscribeFrames(Napi::Env env, const FrameSubscriptionSettings &subscriptionSettings,
+                            const Napi::Function &callback) {
+    video_t *video = obs_get_video();
+    if (!subscriptionSettings.offscreenDisplay.empty()) {
+        auto found = offscreenDisplays.find(subscriptionSettings.offscreenDisplay);
+        if (found == offscreenDisplays.end()) {
+            throw std::logic_error("Can't find offscreen display: " + subscriptionSettings.offscreenDisplay);
+        }
+        video = found->second->getVideo();
+    }
+    int subscriptionId = ++nextSubscriptionId;
+    frameSubscriptions[subscriptionId] = new FrameSubscription(env, callback, video, subscriptionSettings);
+    return subscriptionId;
+}
+
+void Studio::unsubscribeFrames(int subscriptionId) {
+    auto found = frameSubscriptions.find(subscriptionId);
+    if (found == frameSubscriptions.end()) {
+        throw std::logic_error("Can't find frame subscription: " + std::to_string(subscriptionId));
+    }
+    FrameSubscription *subscription = found->second;
+    frameSubscriptions.erase(found);
+    delete subscription;
 }
 
 Napi::Object Studio::getAudio(Napi::Env env) {
@@ -440,6 +795,18 @@ std::map<std::string, Overlay *> &Studio::getOverlays() {
     return overlays;
 }
 
+void Studio::setCurrentScene(Scene *scene) {
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    if (currentScene) {
+        currentScene->setOnProgram(false);
+    }
+    currentScene = scene;
+    if (currentScene) {
+        currentScene->setOnProgram(true);
+        currentScene->unprepare(false);
+    }
+}
+
 Scene *Studio::findScene(std::string &sceneId) {
     auto it = scenes.find(sceneId);
     if (it == scenes.end()) {
@@ -448,6 +815,45 @@ Scene *Studio::findScene(std::string &sceneId) {
     return it->second;
 }
 
+std::vector<std::shared_ptr<SourceHandle>> Studio::findHandles(const std::vector<DisplaySource> &displaySources) {
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    std::vector<std::shared_ptr<SourceHandle>> handles;
+    for (auto displaySource : displaySources) {
+        if (!displaySource.sceneId.empty()) {
+            Scene *scene = findScene(displaySource.sceneId);
+            handles.push_back(displaySource.sourceId.empty() ?
+                              scene->getHandle() :
+                              scene->findSource(displaySource.sourceId)->getHandle());
+            continue;
+        }
+
+        // A plain id is a scene id, or a source id in any scene.
+        auto sceneIt = scenes.find(displaySource.sourceId);
+        if (sceneIt != scenes.end()) {
+            handles.push_back(sceneIt->second->getHandle());
+            continue;
+        }
+        std::shared_ptr<SourceHandle> handle;
+        for (const auto &scene : scenes) {
+            auto &sources = scene.second->getSources();
+            auto sourceIt = sources.find(displaySource.sourceId);
+            if (sourceIt == sources.end()) {
+                continue;
+            }
+            if (handle) {
+                blog(LOG_WARNING, "Source %s is in more than one scene, use { sceneId, sourceId } to choose one",
+                     displaySource.sourceId.c_str());
+                break;
+            }
+            handle = sourceIt->second->getHandle();
+        }
+        if (handle) {
+            handles.push_back(handle);
+        }
+    }
+    return handles;
+}
+
 std::string Studio::getObsBinPath() {
 #ifdef _WIN32
     return obsPath + "\\bin\\64bit";
@@ -3,9 +3,17 @@
 #include "settings.h"
 #include "scene.h"
 #include "display.h"
+#include "offscreen_display.h"
+#include "frame_tap.h"
+#include "frame_subscription.h"
 #include "output.h"
 #include "overlay.h"
+#include "source_pool.h"
+#include "tbar.h"
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <obs.h>
 #include "utils.h"
 
@@ -21,6 +29,15 @@ public:
     static std::string getObsPluginPath();
     static std::string getObsPluginDataPath();
 
+    // Benchmarks run on their own threads against the running obs, shutdown
+    // aborts them and waits until they have cleaned up.
+    static void beginBenchmark();
+    static void endBenchmark();
+    static bool isBenchmarkAborted();
+
+    // Sleeps for the duration, false when shutdown aborted the benchmarks meanwhile.
+    static bool benchmarkSleep(std::chrono::milliseconds duration);
+
     explicit Studio(Settings *settings);
 
     void startup();
@@ -33,6 +50,12 @@ public:
 
     void removeOutput(const std::string &outputId);
 
+    Napi::Object getOutputStats(Napi::Env env, const std::string &outputId);
+
+    void saveReplay(const std::string &outputId, const std::string &path, Output::ReplayCallback callback);
+
+    void playReplay(const std::string &outputId, std::string &sceneId, std::string &sourceId, Napi::Object &settings);
+
     void addScene(std::string &sceneId);
 
     void removeScene(std::string &sceneId);
@@ -41,15 +64,47 @@ public:
 
     Source *findSource(std::string &sceneId, std::string &sourceId);
 
-    void switchToScene(std::string &sceneId, std::string &transitionType, int transitionMs, uint64_t timestamp, int tBarValue = 0);
+    void switchToScene(std::string &sceneId, std::string &transitionType, int transitionMs, uint64_t timestamp,
+                       int tBarValue = 0, uint64_t tBarTimestamp = 0);
 
-    void createDisplay(std::string &displayName, void *parentHandle, int scaleFactor, const std::vector<std::string> &sourceIds);
+    void loadTransition(const std::string &transitionType, const std::string &settingsJson);
+
+    void prepareScene(std::string &sceneId);
+
+    void unprepareScene(std::string &sceneId);
+
+    void createDisplay(std::string &displayName, void *parentHandle, int scaleFactor, const std::vector<DisplaySource> &displaySources,
+                       const DisplaySettings &displaySettings);
 
     void destroyDisplay(std::string &displayName);
 
     void moveDisplay(std::string &displayName, int x, int y, int width, int height);
 
-    void updateDisplay(std::string &displayName, const std::vector<std::string> &sourceIds);
+    void updateDisplay(std::string &displayName, const std::vector<DisplaySource> &displaySources);
+
+    void pauseDisplay(std::string &displayName);
+
+    void resumeDisplay(std::string &displayName);
+
+    Napi::Object getDisplayStats(Napi::Env env, std::string &displayName);
+
+    void createOffscreenDisplay(std::string &displayName, const std::vector<DisplaySource> &displaySources,
+                                const OffscreenDisplaySettings &displaySettings);
+
+    void destroyOffscreenDisplay(std::string &displayName);
+
+    void updateOffscreenDisplay(std::string &displayName, const std::vector<DisplaySource> &displaySources);
+
+    Napi::Value getOffscreenDisplayFrame(Napi::Env env, std::string &displayName);
+
+    void addFrameTap(const std::string &frameTapId, const FrameTapSettings &frameTapSettings);
+
+    void removeFrameTap(const std::string &frameTapId);
+
+    int subscribeFrames(Napi::Env env, const FrameSubscriptionSettings &subscriptionSettings,
+                        const Napi::Function &callback);
+
+    void unsubscribeFrames(int subscriptionId);
 
     Napi::Object getAudio(Napi::Env env);
 
@@ -69,14 +124,29 @@ private:
     static void loadModule(const std::string &binPath, const std::string &dataPath);
     static void delay_switch_callback(void *param);
     Scene *findScene(std::string &sceneId);
+
+    std::vector<std::shared_ptr<SourceHandle>> findHandles(const std::vector<DisplaySource> &displaySources);
+    void waitSceneReady(std::string &sceneId);
+    obs_source_t *findTransition(const std::string &transitionType);
+    void setCurrentScene(Scene *scene);
     uint64_t getSourceTimestamp(std::string &sceneId);
 
     static std::string obsPath;
     static std::function<bool(std::function<void()>)> cef_queue_task_callback;
+    static std::mutex benchmark_mtx;
+    static std::condition_variable benchmark_cv;
+    static int runningBenchmarks;
+    static bool abortBenchmarks;
     Settings *settings;
+    SourcePool *sourcePool;
+    PreviewCache *previewCache;
     std::map<std::string, Scene *> scenes;
     std::map<std::string, obs_source_t *> transitions;
     std::map<std::string, Display *> displays;
+    std::map<std::string, OffscreenDisplay *> offscreenDisplays;
+    std::map<std::string, FrameTap *> frameTaps;
+    std::map<int, FrameSubscription *> frameSubscriptions;
+    int nextSubscriptionId;
     std::map<std::string, Overlay *> overlays;
     Scene *currentScene;
     std::map<std::string, Output *> outputs;
@@ -85,4 +155,5 @@ private:
     std::thread delay_switch_thread;
     queue<DelaySwitchData *> delay_switch_queue;
     bool tBarActive;
+    TBarController *tBarController;
 };
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "tbar.h"
+#include <util/platform.h>
+
+TBarController::TBarController(Settings *settings) :
+        delayNs((uint64_t) settings->tBarSmoothingMs * 1000000ULL),
+        mtx(),
+        samples(),
+        transition(nullptr),
+        clockOffset(0),
+        hasClockOffset(false),
+        finishing(false) {
+    obs_add_main_render_callback(render_callback, this);
+}
+
+TBarController::~TBarController() {
+    obs_remove_main_render_callback(render_callback, this);
+}
+
+void TBarController::start(obs_source_t *t) {
+    std::unique_lock<std::mutex> lock(mtx);
+    transition = t;
+    samples.clear();
+    hasClockOffset = false;
+    finishing = false;
+}
+
+void TBarController::push(float position, uint64_t timestampMs) {
+    auto now = (int64_t) os_gettime_ns();
+    int64_t timestamp = timestampMs > 0 ? (int64_t) timestampMs * 1000000LL : now;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    // The smallest observed offset is the one with the least network delay,
+    // use it to map client timestamps to local time.
+    if (!hasClockOffset || now - timestamp < clockOffset) {
+        clockOffset = now - timestamp;
+        hasClockOffset = true;
+    }
+    if (!samples.empty() && timestamp <= samples.back().timestamp) {
+        // out of order or duplicated sample, keep the latest position only
+        samples.back().position = position;
+        return;
+    }
+    samples.push_back(Sample{
+            .timestamp = timestamp,
+            .position = position,
+    });
+}
+
+void TBarController::finish() {
+    std::unique_lock<std::mutex> lock(mtx);
+    finishing = true;
+}
+
+void TBarController::render_callback(void *param, uint32_t cx, uint32_t cy) {
+    UNUSED_PARAMETER(cx);
+    UNUSED_PARAMETER(cy);
+    auto controller = (TBarController *) param;
+
+    std::unique_lock<std::mutex> lock(controller->mtx);
+    if (!controller->transition || controller->samples.empty()) {
+        return;
+    }
+
+    int64_t playbackTime = (int64_t) os_gettime_ns() - (int64_t) controller->delayNs - controller->clockOffset;
+    float position = controller->getPosition(playbackTime);
+    obs_transition_set_manual_time(controller->transition, position);
+
+    if (controller->finishing && controller->samples.size() == 1 &&
+        playbackTime >= controller->samples.front().timestamp) {
+        controller->transition = nullptr;
+        controller->samples.clear();
+        controller->finishing = false;
+    }
+}
+
+float TBarController::getPosition(int64_t playbackTime) {
+    while (samples.size() > 1 && samples[1].timestamp <= playbackTime) {
+        samples.pop_front();
+    }
+    const Sample &from = samples.front();
+    if (samples.size() == 1 || playbackTime <= from.timestamp) {
+        return from.position;
+    }
+    const Sample &to = samples[1];
+    double t = (double) (playbackTime - from.timestamp) / (double) (to.timestamp - from.timestamp);
+    return from.position + (float) ((to.position - from.position) * t);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "settings.h"
+#include <deque>
+#include <mutex>
+#include <obs.h>
+
+// Drive a manual transition from timestamped T-bar positions. Positions are
+// replayed with a small delay and interpolated on every rendered frame, so
+// bursty updates from the client still move the transition smoothly.
+class TBarController {
+
+public:
+    explicit TBarController(Settings *settings);
+    ~TBarController();
+
+    void start(obs_source_t *transition);
+
+    void push(float position, uint64_t timestampMs);
+
+    void finish();
+
+private:
+    struct Sample {
+        int64_t timestamp; // client time in nanoseconds
+        float position;
+    };
+
+    static void render_callback(void *param, uint32_t cx, uint32_t cy);
+
+    float getPosition(int64_t playbackTime);
+
+    uint64_t delayNs;
+    std::mutex mtx;
+    std::deque<Sample> samples;
+    obs_source_t *transition;
+    int64_t clockOffset;
+    bool hasClockOffset;
+    bool finishing;
+};
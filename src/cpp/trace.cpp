@@ -0,0 +1,151 @@
+#include "trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+std::atomic<bool> Trace::enabled(false);
+int Trace::capacity = 0;
+int Trace::nextTid = 1;
+uint64_t Trace::startTime = 0;
+std::vector<std::unique_ptr<Trace::ThreadBuffer>> Trace::buffers;
+std::mutex Trace::trace_mtx;
+
+static std::string escapeJson(const std::string &value) {
+    std::string result;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if ((unsigned char) c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            result += buf;
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+void Trace::start(int eventsPerThread) {
+    if (eventsPerThread <= 0) {
+        throw std::invalid_argument("eventsPerThread should be positive");
+    }
+    std::unique_lock<std::mutex> lock(trace_mtx);
+    enabled = false;
+    capacity = eventsPerThread;
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](std::unique_ptr<ThreadBuffer> &buffer) {
+        std::unique_lock<std::mutex> bufferLock(buffer->mtx);
+        return buffer->exited;
+    }), buffers.end());
+    for (auto &buffer : buffers) {
+        std::unique_lock<std::mutex> bufferLock(buffer->mtx);
+        buffer->events.assign(capacity, {});
+        buffer->next = 0;
+        buffer->wrapped = false;
+    }
+    startTime = os_gettime_ns();
+    enabled = true;
+}
+
+void Trace::stop() {
+    enabled = false;
+}
+
+// Marks the buffer of a thread as exited when the thread ends, its events stay
+// for the dump until the next start. The buffer is only created by the first
+// event, the thread's name waits here until then.
+struct ThreadBufferHolder {
+    Trace::ThreadBuffer *buffer = nullptr;
+    std::string name;
+
+    ~ThreadBufferHolder() {
+        if (buffer) {
+            std::unique_lock<std::mutex> lock(buffer->mtx);
+            buffer->exited = true;
+        }
+    }
+};
+
+static thread_local ThreadBufferHolder holder;
+
+Trace::ThreadBuffer *Trace::getThreadBuffer() {
+    if (!holder.buffer) {
+        std::unique_lock<std::mutex> lock(trace_mtx);
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->tid = nextTid++;
+        buffer->name = holder.name;
+        buffer->events.assign(enabled ? capacity : 0, {});
+        holder.buffer = buffer.get();
+        buffers.push_back(std::move(buffer));
+    }
+    return holder.buffer;
+}
+
+void Trace::record(const char *name, uint64_t startNs, uint64_t endNs) {
+    if (!isEnabled()) {
+        return;
+    }
+    ThreadBuffer *buffer = getThreadBuffer();
+    std::unique_lock<std::mutex> lock(buffer->mtx);
+    if (buffer->events.empty()) {
+        return;
+    }
+    buffer->events[buffer->next] = {name, startNs, endNs - startNs};
+    if (++buffer->next == buffer->events.size()) {
+        buffer->next = 0;
+        buffer->wrapped = true;
+    }
+}
+
+void Trace::setThreadName(const std::string &name) {
+    holder.name = name;
+    if (holder.buffer) {
+        std::unique_lock<std::mutex> lock(holder.buffer->mtx);
+        holder.buffer->name = name;
+    }
+}
+
+std::string Trace::dump() {
+    std::unique_lock<std::mutex> lock(trace_mtx);
+    std::string result = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char buf[256];
+    for (auto &buffer : buffers) {
+        // Copy first, the thread keeps recording meanwhile.
+        std::vector<Event> events;
+        std::string name;
+        {
+            std::unique_lock<std::mutex> bufferLock(buffer->mtx);
+            if (buffer->wrapped) {
+                events.assign(buffer->events.begin() + buffer->next, buffer->events.end());
+            }
+            events.insert(events.end(), buffer->events.begin(), buffer->events.begin() + buffer->next);
+            name = buffer->name;
+        }
+        if (events.empty()) {
+            continue;
+        }
+
+        if (!name.empty()) {
+            result += first ? "" : ",";
+            result += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(buffer->tid) +
+                      ",\"args\":{\"name\":\"" + escapeJson(name) + "\"}}";
+            first = false;
+        }
+        for (auto &event : events) {
+            if (event.startNs < startTime) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf),
+                     "%s{\"name\":\"%s\",\"cat\":\"obs-node\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                     "\"ts\":%.3f,\"dur\":%.3f}",
+                     first ? "" : ",", event.name, buffer->tid,
+                     (double) (event.startNs - startTime) / 1000.0, (double) event.durationNs / 1000.0);
+            result += buf;
+            first = false;
+        }
+    }
+    result += "]}";
+    return result;
+}
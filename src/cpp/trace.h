@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <util/platform.h>
+
+#define TRACE_DEFAULT_EVENTS 65536 // per thread
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Records the enclosing scope as a trace event, name must be a string literal.
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+// Scoped events of the hot paths, kept in a ring buffer per thread while
+// tracing is on and dumped in the Chrome trace-event format, to be opened in
+// chrome://tracing or Perfetto. When tracing is off a scope costs one
+// relaxed atomic load.
+class Trace {
+
+public:
+    struct Event {
+        const char *name;
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    struct ThreadBuffer {
+        int tid = 0;
+        std::string name;
+        std::vector<Event> events;
+        size_t next = 0;
+        bool wrapped = false;
+        bool exited = false;
+        std::mutex mtx; // Only contended while dumping
+    };
+
+    static void start(int eventsPerThread);
+
+    static void stop();
+
+    static inline bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static void record(const char *name, uint64_t startNs, uint64_t endNs);
+
+    // Names the calling thread in the dump, cheap while tracing is off.
+    static void setThreadName(const std::string &name);
+
+    // Events of all threads since start, the oldest ones of a thread are
+    // overwritten once its ring is full.
+    static std::string dump();
+
+private:
+    static ThreadBuffer *getThreadBuffer();
+
+    static std::atomic<bool> enabled;
+    static int capacity;
+    static int nextTid;
+    static uint64_t startTime;
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    static std::mutex trace_mtx;
+};
+
+class TraceScope {
+
+public:
+    explicit TraceScope(const char *name) : name(name), startNs(Trace::isEnabled() ? os_gettime_ns() : 0) {}
+
+    ~TraceScope() {
+        if (startNs) {
+            Trace::record(name, startNs, os_gettime_ns());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    uint64_t startNs;
+};
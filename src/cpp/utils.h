@@ -69,6 +69,11 @@ public:
         return value.IsUndefined() ? std::nullopt : std::optional<bool>{value.As<Napi::Boolean>()};
     }
 
+    static inline std::string stringify(Napi::Env env, const Napi::Value &value) {
+        auto json = env.Global().Get("JSON").As<Napi::Object>();
+        return json.Get("stringify").As<Napi::Function>().Call(json, {value}).As<Napi::String>();
+    }
+
     static inline std::vector<std::string> getStringArray(const Napi::Array &array) {
         std::vector<std::string> result;
         for (uint32_t i = 0; i < array.Length(); ++i) {
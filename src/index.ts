@@ -28,7 +28,10 @@ declare namespace obs {
 
     export type Position = 'top' | 'top-right' | 'right' | 'bottom-right' | 'bottom' | 'bottom-left' | 'left' | 'top-left' | 'center';
 
-    export type TransitionType = 'cut_transition' | 'fade_transition' | 'swipe_transition' | 'slide_transition';
+    export type TransitionType = 'cut_transition' | 'fade_transition' | 'swipe_transition' | 'slide_transition' |
+        'fade_to_color_transition' | 'wipe_transition' | 'obs_stinger_transition';
+
+    export type DisplayLayout = 'default' | 'multiview';
 
     export type AudioMode = 'follow' | 'standalone';
 
@@ -51,6 +54,33 @@ declare namespace obs {
         sampleRate: number;
     }
 
+    export interface TransitionSettings {
+        type: TransitionType;
+        settings?: Record<string, unknown>;
+    }
+
+    export type SrtMode = 'caller' | 'listener' | 'rendezvous';
+
+    // 'ffmpeg' pipes to the obs-ffmpeg-mux process, 'native' writes FLV in process.
+    export type RecordWriter = 'ffmpeg' | 'native';
+
+    export type FsyncPolicy = 'none' | 'interval' | 'close';
+
+    export interface SrtSettings {
+        latencyMs?: number;
+        passphrase?: string;
+        mode?: SrtMode;
+        streamId?: string;
+    }
+
+    export interface SegmentSettings {
+        path: string; // .m3u8 for HLS, .mpd for DASH/CMAF, segments are written next to it
+        segmentSec?: number; // Defaults to 2
+        partMs?: number; // Low latency chunks, .mpd only
+        windowSize?: number; // Segments kept in the playlist, defaults to 10
+        deleteSegments?: boolean; // Delete segments leaving the window, defaults to true
+    }
+
     export interface OutputSettings {
         url: string;
         hardwareEnable: boolean;
@@ -62,13 +92,119 @@ declare namespace obs {
         profile: string;
         tune: string;
         x264opts?: string;
+        videoEncoder?: string; // libobs encoder id, defaults to ffmpeg_nvenc or obs_x264 by hardwareEnable
+        videoEncoderSettings?: Record<string, unknown>; // Encoder specific, applied over the common settings
+        encoderCores?: string; // Core set for the encoder threads like '0-7,16', Linux only
+        threadCores?: string; // Core set for the transcoder and monitor threads of this output
         videoBitrateKbps: number;
         audioBitrateKbps: number;
         delaySec?: number;
         mixers?: number;
         recordEnable?: boolean;
-        recordFilePath?: string;
+        recordFilePath?: string; // A .flv file for the 'native' writer
+        recordWriter?: RecordWriter; // Defaults to 'ffmpeg'
+        recordBufferMb?: number; // Write-ahead buffer of the native writer, defaults to 64
+        recordFsync?: FsyncPolicy; // Defaults to 'interval'
+        recordFsyncIntervalMs?: number; // Defaults to 1000
         enableAbsoluteTimestamp?: boolean;
+        dynamicBitrate?: boolean; // Needs an encoder with dynamic bitrate support, not combinable with record, segment or replay
+        minVideoBitrateKbps?: number; // Defaults to a quarter of videoBitrateKbps
+        maxVideoBitrateKbps?: number; // Defaults to videoBitrateKbps
+        autoReconnect?: boolean;
+        reconnectDelayMs?: number; // First retry delay, doubled on each attempt
+        reconnectMaxDelayMs?: number;
+        reconnectMaxRetries?: number; // 0 retries forever
+        srt?: SrtSettings; // For srt:// urls
+        segment?: SegmentSettings | null;
+        replaySec?: number; // Keep the last replaySec of encoded packets for saveReplay, 0 disables it
+        replayMaxMemoryMb?: number; // Defaults to 512
+    }
+
+    export interface DisplaySettings {
+        layout?: DisplayLayout;
+        columns?: number;
+        fps?: number;
+    }
+
+    export type DisplaySource = string | { sceneId: string, sourceId?: string };
+
+    export interface OffscreenDisplaySettings {
+        width: number;
+        height: number;
+        fps?: number;
+        columns?: number;
+        output?: OutputSettings;
+    }
+
+    export interface OffscreenDisplayFrame {
+        width: number;
+        height: number;
+        format: 'BGRA';
+        timestamp: number;
+        data: Buffer;
+    }
+
+    export type FrameTapVideoFormat = 'NV12' | 'BGRA';
+
+    export interface FrameTapSettings {
+        name: string; // POSIX shared memory name, e.g. '/obs-program'
+        offscreenDisplay?: string; // Defaults to the program output
+        videoFormat?: FrameTapVideoFormat;
+        width?: number;
+        height?: number;
+        audio?: boolean;
+        slots?: number;
+    }
+
+    export type FrameFormat = 'BGRA' | 'RGBA' | 'NV12' | 'I420';
+
+    export interface FrameSubscriptionSettings {
+        offscreenDisplay?: string; // Defaults to the program output
+        format?: FrameFormat;
+        width?: number; // Height keeps the aspect ratio
+        fps?: number;
+        poolSize?: number;
+    }
+
+    export interface Frame {
+        data: ArrayBuffer; // Pooled memory, don't use it after release()
+        width: number;
+        height: number;
+        format: FrameFormat;
+        timestamp: number;
+        dropped: number;
+        release(): void;
+    }
+
+    export type FrameCallback = (frame: Frame) => void;
+
+    export interface DisplayStats {
+        fps: number;
+        paused: boolean;
+        renderedFrames: number;
+        skippedFrames: number;
+        averageRenderTimeMs: number; // Of the preview render, measured by renderTimeClock
+        maxRenderTimeMs: number;
+        renderTimeClock: 'gpu' | 'cpu'; // GPU time with libobs 27 or later, CPU submission time before
+        outputRenderTimeMs: number;
+    }
+
+    // Core sets per thread class like '0-7,16', Linux only.
+    export interface AffinitySettings {
+        render?: string; // Graphics, video output and offscreen display threads
+        audio?: string;
+        encoder?: string;
+        transcoder?: string; // SourceTranscoder video threads
+        output?: string; // Output monitor and record writer threads
+        control?: string;
+    }
+
+    export interface ThreadPlacement {
+        tid: number;
+        name: string;
+        threadClass?: string; // Threads created by obs-node
+        cores: string;
+        cpu?: number; // Core it last ran on, Linux only
     }
 
     export interface Settings {
@@ -79,6 +215,16 @@ declare namespace obs {
         timestampFontHeight?: number;
         multiSourceSyncThreshold?: number;
         multiSourceSyncMaxDistance?: number;
+        sourcePoolGraceSec?: number;
+        shareSources?: boolean;
+        sceneReadyTimeoutMs?: number;
+        tBarSmoothingMs?: number;
+        encoderCpuCores?: number; // Cores shared by all x264 encoders by resolution, 0 leaves x264 defaults
+        encoderCpuPixels?: number; // Frame pixels of all x264 encoders expected at once, e.g. 4 * 1280 * 720, sizes the shares from the first encoder
+        affinity?: AffinitySettings;
+        metricsPort?: number; // Serves getMetrics() on http://metricsHost:metricsPort/metrics, 0 disables it
+        metricsHost?: string; // Defaults to 127.0.0.1
+        transitions?: TransitionSettings[];
         video: VideoSettings;
         audio: AudioSettings;
     }
@@ -96,6 +242,7 @@ declare namespace obs {
         bufferingMb?: number;
         reconnectDelaySec?: number;
         mixers?: number;
+        srt?: SrtSettings; // For srt:// urls
         output?: OutputSettings | null;
     }
 
@@ -117,6 +264,106 @@ declare namespace obs {
         peak: number[],
         input_peak: number[]) => void;
 
+    export interface RecordStats {
+        active: boolean;
+        bytesWritten: number;
+        bitrateKbps: number;
+        totalFrames?: number;
+        droppedFrames?: number;
+        bufferedBytes?: number; // Native writer only
+        droppedPackets?: number; // Native writer only
+    }
+
+    export interface SegmentStats {
+        active: boolean;
+        bytesWritten: number;
+        totalFrames: number;
+        droppedFrames: number;
+    }
+
+    export interface ReplayStats {
+        active: boolean;
+        bufferedSec: number;
+        memoryBytes: number;
+        maxSec: number;
+        maxMemoryMb: number;
+        lastReplayPath: string;
+    }
+
+    export interface EncoderBenchmarkSettings {
+        encoders: { id: string, settings?: Record<string, unknown> }[];
+        width: number;
+        height: number;
+        bitrateKbps?: number; // Defaults to 4000
+        durationSec?: number; // Per encoder, defaults to 10
+    }
+
+    export interface EncoderBenchmarkResult {
+        encoder: string;
+        settings: string; // JSON
+        fps: number;
+        targetFps: number;
+        cpuPercent: number; // Of the whole machine
+        skippedFrames: number;
+        error?: string;
+    }
+
+    export interface PipelineBenchmarkSettings {
+        sources?: number; // Defaults to 1
+        input?: string; // Media file looped by every source, a synthetic test pattern when not set
+        inputWidth?: number; // Of the test pattern, defaults to 1920
+        inputHeight?: number; // Of the test pattern, defaults to 1080
+        inputFps?: number; // Of the test pattern, defaults to 25
+        output: Omit<OutputSettings, 'url'>;
+        sink?: 'null' | 'file'; // Defaults to null
+        outputDir?: string; // Required by the file sink
+        warmupSec?: number; // Defaults to 5
+        durationSec?: number; // Defaults to 30
+    }
+
+    export interface PipelineBenchmarkSourceResult {
+        sourceId: string;
+        fps: number;
+        skippedFrames: number;
+        latencyP50Ms: number; // From the decoder to the encoder input
+        latencyP99Ms: number;
+        latencySamples: number;
+    }
+
+    export interface PipelineBenchmarkResult {
+        sources: PipelineBenchmarkSourceResult[];
+        targetFps: number;
+        cpuPercent: number; // Of the whole machine
+        cpuPercentPerSource: number;
+        residentMb: number; // Only known on Linux
+    }
+
+    export interface OutputStats {
+        active: boolean;
+        bytesSent?: number;
+        bitrateKbps?: number; // Measured in the last second
+        videoBitrateKbps?: number; // Current encoder setting
+        totalFrames?: number;
+        networkDroppedFrames?: number;
+        videoSkippedFrames?: number; // Of the source or offscreen display video, not set for the shared program video
+        congestion?: number;
+        connectTimeMs?: number;
+        reconnectCount?: number;
+        encoderLatencyMs?: number;
+        record?: RecordStats;
+        segment?: SegmentStats;
+        replay?: ReplayStats;
+    }
+
+    export interface BitrateChange {
+        bitrateKbps: number;
+        previousBitrateKbps: number;
+        congestion: number;
+        droppedFrames: number;
+    }
+
+    export type BitrateCallback = (outputId: string, change: BitrateChange) => void;
+
     export interface Overlay {
         id: string;
         name: string;
@@ -160,18 +407,43 @@ declare namespace obs {
         getSourceServerTimestamp(sceneId: string, sourceId: string): string;
         updateSource(sceneId: string, sourceId: string, settings: Partial<SourceSettings>): void;
         restartSource(sceneId: string, sourceId: string): void;
-        switchToScene(sceneId: string, transitionType: TransitionType, transitionMs: number, timestamp?: string, tBarValue?: number): void;
+        switchToScene(sceneId: string, transitionType: TransitionType, transitionMs: number, timestamp?: string, tBarValue?: number, tBarTimestamp?: number): void;
+        loadTransition(transitionType: TransitionType, settings?: Record<string, unknown>): void;
+        prepareScene(sceneId: string): void;
+        unprepareScene(sceneId: string): void;
         addOutput(outputId: string, settings: OutputSettings);
         updateOutput(outputId: string, settings: OutputSettings);
         removeOutput(outputId: string);
-        createDisplay(name: string, parentWindow: Buffer, scaleFactor: number, sourceIds: string[]): void;
+        getOutputStats(outputId: string): OutputStats;
+        saveReplay(outputId: string, path: string): Promise<string>; // Resolves with the saved path
+        playReplay(outputId: string, sceneId: string, sourceId: string, settings?: Partial<SourceSettings>): void;
+        createDisplay(name: string, parentWindow: Buffer, scaleFactor: number, sources: DisplaySource[], settings?: DisplaySettings): void;
         destroyDisplay(name: string): void;
-        updateDisplay(name: string, sourceIds: string[]): void;
+        updateDisplay(name: string, sources: DisplaySource[]): void;
         moveDisplay(name: string, x: number, y: number, width: number, height: number): void;
+        pauseDisplay(name: string): void;
+        resumeDisplay(name: string): void;
+        getDisplayStats(name: string): DisplayStats;
+        createOffscreenDisplay(name: string, sources: DisplaySource[], settings: OffscreenDisplaySettings): void;
+        destroyOffscreenDisplay(name: string): void;
+        updateOffscreenDisplay(name: string, sources: DisplaySource[]): void;
+        getOffscreenDisplayFrame(name: string): OffscreenDisplayFrame | null;
+        addFrameTap(frameTapId: string, settings: FrameTapSettings): void;
+        removeFrameTap(frameTapId: string): void;
+        subscribeFrames(settings: FrameSubscriptionSettings, callback: FrameCallback): number;
+        unsubscribeFrames(subscriptionId: number): void;
         addVolmeterCallback(callback: VolmeterCallback): void;
+        addBitrateCallback(callback: BitrateCallback): void;
         getAudio(): Audio;
         updateAudio(audio: Partial<Audio>): void;
         screenshot(sceneId: string, sourceId: string): Promise<Buffer>;
+        benchmarkEncoders(settings: EncoderBenchmarkSettings): Promise<EncoderBenchmarkResult[]>; // Rejected when shutdown aborts it
+        benchmarkPipeline(settings: PipelineBenchmarkSettings): Promise<PipelineBenchmarkResult>; // Rejected when shutdown aborts it
+        getThreadPlacement(): ThreadPlacement[];
+        getMetrics(): string; // Prometheus text format
+        startTrace(eventsPerThread?: number): void; // Events kept per thread, defaults to 65536
+        stopTrace(): void;
+        dumpTrace(): string; // Chrome trace-event JSON, opens in chrome://tracing or Perfetto
         addOverlay(overlay: Overlay): void;
         removeOverlay(overlayId: string): void;
         upOverlay(overlayId: string): void;
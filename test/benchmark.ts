@@ -0,0 +1,113 @@
+import * as fs from 'fs';
+import * as path from 'path';
+import * as obs from '../src';
+
+// Headless benchmark of the source transcoding pipelines, no endpoints needed.
+// BENCHMARK_SOURCES        sources run at once, defaults to 4
+// BENCHMARK_INPUT          media file looped by every source, a synthetic test pattern when not set
+// BENCHMARK_SINK           'null' or 'file', defaults to null
+// BENCHMARK_OUTPUT_DIR     where the file sink writes
+// BENCHMARK_DURATION_SEC   measured time, defaults to 30
+// BENCHMARK_RESULT         writes the result as JSON
+// BENCHMARK_BASELINE       a previous result, exits with 1 when this run regressed against it
+
+const FPS_TOLERANCE = 0.05;
+const LATENCY_TOLERANCE = 0.2;
+const LATENCY_SLACK_MS = 2;
+const CPU_TOLERANCE = 0.1;
+
+const settings: obs.Settings = {
+    video: {
+        baseWidth: 1280,
+        baseHeight: 720,
+        outputWidth: 1280,
+        outputHeight: 720,
+        fpsNum: 25,
+        fpsDen: 1,
+    },
+    audio: {
+        sampleRate: 44100,
+    },
+};
+
+const benchmarkSettings: obs.PipelineBenchmarkSettings = {
+    sources: Number(process.env.BENCHMARK_SOURCES || 4),
+    input: process.env.BENCHMARK_INPUT,
+    inputWidth: 1920,
+    inputHeight: 1080,
+    inputFps: 25,
+    sink: process.env.BENCHMARK_SINK === 'file' ? 'file' : 'null',
+    outputDir: process.env.BENCHMARK_OUTPUT_DIR,
+    warmupSec: 5,
+    durationSec: Number(process.env.BENCHMARK_DURATION_SEC || 30),
+    output: {
+        hardwareEnable: false,
+        width: 640,
+        height: 360,
+        keyintSec: 1,
+        rateControl: 'CBR',
+        preset: 'veryfast',
+        profile: 'main',
+        tune: 'zerolatency',
+        videoBitrateKbps: 1000,
+        audioBitrateKbps: 64,
+    },
+};
+
+function compare(result: obs.PipelineBenchmarkResult, baseline: obs.PipelineBenchmarkResult): string[] {
+    const regressions: string[] = [];
+    result.sources.forEach(source => {
+        const base = baseline.sources.find(s => s.sourceId === source.sourceId);
+        if (!base) {
+            return;
+        }
+        if (source.fps < base.fps * (1 - FPS_TOLERANCE)) {
+            regressions.push(`${source.sourceId} fps ${source.fps.toFixed(2)} < ${base.fps.toFixed(2)}`);
+        }
+        if (source.latencyP99Ms > base.latencyP99Ms * (1 + LATENCY_TOLERANCE) + LATENCY_SLACK_MS) {
+            regressions.push(`${source.sourceId} p99 latency ${source.latencyP99Ms.toFixed(1)}ms > ${base.latencyP99Ms.toFixed(1)}ms`);
+        }
+    });
+    if (result.cpuPercentPerSource > baseline.cpuPercentPerSource * (1 + CPU_TOLERANCE)) {
+        regressions.push(`CPU per source ${result.cpuPercentPerSource.toFixed(1)}% > ${baseline.cpuPercentPerSource.toFixed(1)}%`);
+    }
+    return regressions;
+}
+
+async function main() {
+    // No window is ever shown, Qt doesn't need a display.
+    if (!process.env.QT_QPA_PLATFORM) {
+        process.env.QT_QPA_PLATFORM = 'offscreen';
+    }
+    obs.startup(settings);
+    let result: obs.PipelineBenchmarkResult;
+    try {
+        result = await obs.benchmarkPipeline(benchmarkSettings);
+    } finally {
+        obs.shutdown();
+    }
+
+    result.sources.forEach(s => {
+        console.log(`${s.sourceId}: ${s.fps.toFixed(2)}/${result.targetFps} fps, skipped ${s.skippedFrames}, ` +
+            `latency p50 ${s.latencyP50Ms.toFixed(1)}ms p99 ${s.latencyP99Ms.toFixed(1)}ms`);
+    });
+    console.log(`CPU ${result.cpuPercent.toFixed(1)}% (${result.cpuPercentPerSource.toFixed(1)}% per source), ` +
+        `RSS ${result.residentMb.toFixed(0)}MB`);
+
+    if (process.env.BENCHMARK_RESULT) {
+        fs.writeFileSync(process.env.BENCHMARK_RESULT, JSON.stringify({settings: benchmarkSettings, result}, null, 2));
+    }
+    if (process.env.BENCHMARK_BASELINE) {
+        const baseline = JSON.parse(fs.readFileSync(path.resolve(process.env.BENCHMARK_BASELINE), 'utf8'));
+        const regressions = compare(result, baseline.result);
+        regressions.forEach(r => console.error(`Regression: ${r}`));
+        if (regressions.length > 0) {
+            process.exit(1);
+        }
+    }
+}
+
+main().catch(e => {
+    console.error(e);
+    process.exit(1);
+});
@@ -152,6 +152,48 @@ const sources: Source[] = [
     }
 ];
 
+// SRT loopback, the program is pushed to a local SRT listener and pulled back as a source.
+// Needs obs built with an FFmpeg that has libsrt, enabled with SRT_LOOPBACK=1.
+if (process.env.SRT_LOOPBACK) {
+    outputs.push({
+        id: 'srt',
+        settings: {
+            url: 'srt://127.0.0.1:9000',
+            hardwareEnable: false,
+            width: 640,
+            height: 360,
+            keyintSec: 1,
+            rateControl: 'CBR',
+            preset: 'ultrafast',
+            profile: 'main',
+            tune: 'zerolatency',
+            videoBitrateKbps: 1000,
+            audioBitrateKbps: 64,
+            srt: {
+                mode: 'listener',
+                latencyMs: 120,
+                passphrase: 'obs-node-loopback',
+            },
+        },
+    });
+    sources.push({
+        sceneId: 'scene3',
+        sourceId: 'source3',
+        settings: {
+            name: 'source3',
+            type: 'live',
+            url: 'srt://127.0.0.1:9000',
+            hardwareDecoder: false,
+            playOnActive: false,
+            srt: {
+                mode: 'caller',
+                latencyMs: 120,
+                passphrase: 'obs-node-loopback',
+            },
+        },
+    });
+}
+
 obs.startup(settings);
 
 sources.forEach(s => {